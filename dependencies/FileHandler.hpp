@@ -160,20 +160,24 @@ namespace FileHandler
         return true;
     }
 
-    [[maybe_unused]] bool WriteToFile(const std::filesystem::path& path, const std::string& buffer,
+    template<typename Alloc = std::allocator<char>>
+    [[maybe_unused]] bool WriteToFile(const std::filesystem::path& path, const std::basic_string<char, std::char_traits<char>, Alloc>& buffer,
                                       const std::ios_base::openmode openMode = std::ios::out)
     {
         if(!CreateFile(path))
             return false;
 
-        std::ofstream oStream(path, openMode);
+        // Unbuffered: the whole buffer goes out in one write without the stream allocating a buffer of its own.
+        std::ofstream oStream;
+        oStream.rdbuf()->pubsetbuf(nullptr, 0);
+        oStream.open(path, openMode);
         if(!oStream.is_open())
         {
             std::cerr << "Failed to open: " << path << " : " << std::strerror(errno) << std::endl;
             return false;
         }
 
-        oStream << buffer;
+        oStream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
         if(oStream.fail())
         {
             std::cerr << "Failed to write to file: " << path << " : " << std::strerror(errno) << std::endl;
@@ -185,7 +189,8 @@ namespace FileHandler
         return true;
     }
 
-    [[maybe_unused]] bool ReadFromFile(const fs::path& path, std::string& buffer)
+    template<typename Alloc>
+    [[maybe_unused]] bool ReadFromFile(const fs::path& path, std::basic_string<char, std::char_traits<char>, Alloc>& buffer)
     {
         if(!fs::exists(path))
         {
@@ -499,7 +504,9 @@ namespace FileHandler
         return true;
     }
 
-    [[maybe_unused]] bool GetLinesFromFile(const fs::path& path, std::vector<std::string>& buffer)
+    // Works with any allocator, e.g. std::pmr::vector<std::pmr::string> to keep the lines in an arena.
+    template<typename String, typename Alloc>
+    [[maybe_unused]] bool GetLinesFromFile(const fs::path& path, std::vector<String, Alloc>& buffer)
     {
         if(!fs::exists(path))
         {
@@ -513,13 +520,15 @@ namespace FileHandler
             return false;
         }
 
-        std::string line;
+        String line(buffer.get_allocator());
         while (std::getline(inStream, line))
             buffer.emplace_back(line);
         return true;
     }
 
-    [[maybe_unused]] bool GetLineFromFile(const fs::path& path, std::string& buffer, const std::size_t& line)
+    template<typename Alloc>
+    [[maybe_unused]] bool GetLineFromFile(const fs::path& path, std::basic_string<char, std::char_traits<char>, Alloc>& buffer,
+                                          const std::size_t& line)
     {
         if(!fs::exists(path))
         {
@@ -534,7 +543,7 @@ namespace FileHandler
         }
 
         std::size_t lineCount = 0;
-        std::string l;
+        std::basic_string<char, std::char_traits<char>, Alloc> l(buffer.get_allocator());
         while (lineCount <= line && std::getline(inStream, l))
             lineCount++;
         buffer = l;
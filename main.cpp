@@ -1,8 +1,24 @@
 #include <iostream>
 #include "dependencies/FileHandler.hpp"
 #include "dependencies/TimeHandler.hpp"
+#include "src/TodoList.hpp"
+#include "src/BulkIO.hpp"
+#include "src/Reminders.hpp"
+#include "src/ListWatcher.hpp"
+#include "src/Catalog.hpp"
+#include "src/Archive.hpp"
+#include "src/Session.hpp"
+#include "src/Server.hpp"
+#include "src/EventLoop.hpp"
 #include <istream>
 #include <csignal>
+#include <functional>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
 
 #ifdef _WIN32
 void clearConsole() {
@@ -19,30 +35,44 @@ void printCommands(const std::string& commands)
     std::cout << commands << std::endl;
 }
 
-fs::path addNewTodoList(const fs::path& dirPath, const std::string& listName)
+// Serves file change notifications while the command loop waits, so lists edited by other processes
+// are merged in while the user is idle.
+Todo::Task<void> watchFiles(Todo::Reactor& reactor, Todo::Watcher& watcher,
+                            std::function<void(const std::vector<fs::path>&)> onChange)
 {
-    fs::path path = dirPath;
-    if(!dirPath.string().ends_with('/') && dirPath.string().ends_with('\\'))
-        path += '/';
-    path += listName;
-    path += ".txt";
+    if(watcher.fd() < 0)
+        co_return;
 
-    if(fs::exists(path))
+    while(true)
     {
-       std::cerr << "Failed to create new todo list with name[" << listName << "]. this list already exist" <<std::endl;
-       return {};
+        co_await reactor.readable(watcher.fd());
+        // Writers often close the file several times in a row; let the burst settle first.
+        co_await reactor.sleepFor(std::chrono::milliseconds(20));
+        onChange(watcher.readChanges());
     }
-
-    if(!FileHandler::CreateFile(path))
-        return {};
-    return path;
 }
 
-std::string getUserInput()
+// Advances the reminder wheel once a second, paced by the TimeHandler clock, and hands everything that
+// came due to onDue in one batch.
+Todo::Task<void> watchReminders(Todo::Reactor& reactor, Todo::Reminders& reminders,
+                                std::function<void(std::vector<Todo::Reminder>&)> onDue)
 {
-    std::string inputBuffer;
-    std::getline(std::cin, inputBuffer);
-    return inputBuffer;
+    std::vector<Todo::Reminder> due;
+    TimeHandler::Clock tick(TimeHandler::ClockMode::multi, 1.0);
+    tick.start();
+
+    while(true)
+    {
+        reminders.advance(Todo::Reminders::now(), [&](const Todo::Reminder& reminder) { due.push_back(reminder); });
+        if(!due.empty())
+        {
+            onDue(due);
+            due.clear();
+        }
+
+        while(!tick.check())
+            co_await reactor.sleepFor(std::chrono::milliseconds(250));
+    }
 }
 
 std::string getNext(std::string& input)
@@ -62,55 +92,264 @@ std::string getNext(std::string& input)
     return command;
 }
 
-void printEntries(const std::vector<std::string>& entries)
+void printEntries(const Todo::List& list)
 {
-    for(auto& entry : entries)
-        if(entry.ends_with('\n'))
-            std::cout << entry;
-        else
-            std::cout << entry << std::endl;
+    std::string line;
+    list.forEach([&](const std::size_t& position, const std::uint32_t& slot)
+    {
+        line.clear();
+        list.store().format(slot, line, position + 1);
+        std::cout << line << '\n';
+    });
+    std::cout << std::flush;
 }
 
-struct OnSignalSaveData
+std::string listHeader(const std::string& name, const Todo::List& list)
 {
-    fs::path& mPath;
-    std::vector<std::filesystem::path>& mPaths;
-};
+    std::size_t done = list.store().doneCount();
+    return "Todo list: " + name + " (" + std::to_string(list.size() - done) + " open, " + std::to_string(done) + " done)";
+}
 
-std::unique_ptr<OnSignalSaveData> save_data_ptr;
+void printList(const std::string& name, const std::string& listCommands, const Todo::List& list)
+{
+    clearConsole();
+    std::cout << listHeader(name, list) << std::endl;
+    printCommands(listCommands);
+    printEntries(list);
+}
 
-void signalHandler(int signum)
+// Redraws only the screen lines touched by a reload. Falls back to a full redraw when lines were removed
+// or the list doesn't fit on the terminal, since absolute cursor positions are meaningless then.
+void refreshList(const std::string& name, const std::string& listCommands, const Todo::List& list,
+                 const Todo::ReloadResult& result)
 {
-    std::string outString;
-    for(auto& path : save_data_ptr->mPaths)
-        outString += path.string() + "\n";
+    if(!result.mChanged)
+        return;
 
-    FileHandler::WriteToFile(save_data_ptr->mPath, outString);
+#ifndef _WIN32
+    constexpr std::size_t headerRows = 2;
+    winsize ws{};
+    bool fits = isatty(STDOUT_FILENO) && ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0
+                && headerRows + list.size() < ws.ws_row;
 
-    exit(signum);
+    if(!result.mFullRedraw && fits)
+    {
+        std::string line;
+        std::cout << "\0337\033[1;1H\033[2K" << listHeader(name, list) << "\0338";
+        for(auto index : result.mChangedLines)
+        {
+            line.clear();
+            list.format(index, line);
+            std::cout << "\0337\033[" << headerRows + index + 1 << ";1H\033[2K" << line << "\0338";
+        }
+
+        if(result.mAppendedCount > 0)
+        {
+            std::cout << "\033[" << headerRows + result.mFirstAppended + 1 << ";1H\033[J";
+            for(std::size_t i = result.mFirstAppended; i < list.size(); i++)
+            {
+                line.clear();
+                list.format(i, line);
+                std::cout << line << '\n';
+            }
+        }
+        std::cout << std::flush;
+        return;
+    }
+#endif
+    printList(name, listCommands, list);
 }
 
-int main() {
+bool importFile(const fs::path& listPath, const fs::path& file, std::string& summary)
+{
+    Todo::Format format;
+    if(!Todo::formatOf(file, format))
+    {
+        std::cerr << "Unknown file format[" << file.string() << "]. Use .txt (todo.txt), .csv or .jsonl" << std::endl;
+        return false;
+    }
+
+    std::size_t imported = 0;
+    std::size_t skipped = 0;
+    Todo::Importer importer(format);
+    if(!importer.run(listPath, file, imported, skipped))
+        return false;
+
+    summary = "Imported " + std::to_string(imported) + " entries";
+    if(skipped > 0)
+        summary += ", skipped " + std::to_string(skipped) + " unreadable records";
+    return true;
+}
+
+bool exportFile(const Todo::List& list, const fs::path& file)
+{
+    Todo::Format format;
+    if(!Todo::formatOf(file, format))
+    {
+        std::cerr << "Unknown file format[" << file.string() << "]. Use .txt (todo.txt), .csv or .jsonl" << std::endl;
+        return false;
+    }
+    return Todo::exportEntries(list, file, format);
+}
+
+// --import creates the list if needed, streams the file into it and records the list in the catalog
+// once at the end. --export writes a list out without starting the interactive program.
+int runBulk(const std::string& mode, const fs::path& dirPath, Todo::Catalog& catalog, Todo::Archive& archive,
+            int argc, char** argv)
+{
+    if(argc < 4)
+    {
+        std::cerr << "Use: TodoApp " << mode << " [list] [file]" << std::endl;
+        return 1;
+    }
+
+    fs::path listPath = dirPath;
+    listPath += argv[2];
+    listPath += ".txt";
+    fs::path file(argv[3]);
+
+    if(!archive.promote(catalog, listPath))
+    {
+        std::cerr << "Failed to restore list with name[" << argv[2] << "] from the archive" << std::endl;
+        return 1;
+    }
+    if(mode == "--import")
+    {
+        std::string summary;
+        if(!FileHandler::CreateFile(listPath) || !importFile(listPath, file, summary))
+        {
+            std::cerr << "Failed to import entries from[" << file.string() << "]" << std::endl;
+            return 1;
+        }
+        catalog.add(listPath);
+        catalog.save();
+        std::cout << summary << std::endl;
+        return 0;
+    }
+
+    Todo::List list;
+    if(!list.load(listPath))
+    {
+        std::cerr << "Failed to open list with name[" << argv[2] << "]. This list doesn't exist" << std::endl;
+        return 1;
+    }
+    return exportFile(list, file) ? 0 : 1;
+}
+
+// --archive packs every list that wasn't opened for the given number of days (30 by default).
+int runArchive(Todo::Catalog& catalog, Todo::Archive& archive, int argc, char** argv)
+{
+    unsigned days = 30;
+    if(argc > 2)
+    {
+        std::string_view text(argv[2]);
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), days);
+        if(ec != std::errc() || ptr != text.data() + text.size())
+        {
+            std::cerr << "Use: TodoApp --archive [days]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::size_t packed = 0;
+    if(!archive.pack(catalog, std::chrono::days(days), packed))
+    {
+        std::cerr << "Failed to pack lists into the archive" << std::endl;
+        return 1;
+    }
+    std::cout << "Archived " << packed << " lists, " << archive.size() << " lists in the archive" << std::endl;
+    return 0;
+}
+
+// Saving takes locks and does stream I/O, neither of which may happen inside a signal handler: a signal
+// arriving during a save would wait for the lock the interrupted save holds. The handler only records
+// the signal and wakes the loop through a pipe; the loop stops, and main saves and exits.
+volatile std::sig_atomic_t signalled = 0;
+int signalPipe[2] = {-1, -1};
+
+void signalHandler(int signum)
+{
+    signalled = signum;
+#ifdef __linux__
+    char byte = 0;
+    [[maybe_unused]] ssize_t len = write(signalPipe[1], &byte, 1);
+#endif
+}
+
+void installSignalHandlers()
+{
+#ifdef __linux__
+    if(pipe2(signalPipe, O_NONBLOCK | O_CLOEXEC) < 0)
+        std::cerr << "Failed to create signal pipe : " << std::strerror(errno) << std::endl;
+#endif
 #ifdef _WIN32
     std::signal(SIGBREAK , signalHandler);
 #endif
     std::signal(SIGINT , signalHandler);
+    std::signal(SIGTERM , signalHandler);
+}
+
+// Stops the reactor once a signal arrived. Without epoll the command loop checks signalled itself.
+Todo::Task<void> watchSignals(Todo::Reactor& reactor, int fd)
+{
+    if(fd < 0)
+        co_return;
+
+    co_await reactor.readable(fd);
+    reactor.stop();
+}
 
+int main(int argc, char** argv) {
     fs::path dirPath("todo_lists/");
     fs::path listDirPath("data/paths.txt");
-    fs::path currentTodoList;
+    fs::path socketPath("data/todo.sock");
 
-    std::vector<fs::path> todoListPaths;
-    std::vector<std::string> listDirPathBuffer;
-    save_data_ptr = std::make_unique<OnSignalSaveData>(OnSignalSaveData{listDirPath, todoListPaths});
+    std::string mode = argc > 1 ? argv[1] : "";
+    if(argc > 2)
+        socketPath = argv[2];
 
-    FileHandler::CreateFile(listDirPath);
-    FileHandler::GetLinesFromFile(listDirPath, listDirPathBuffer);
+    if(mode == "--client")
+    {
+#ifdef __linux__
+        return Todo::runClient(socketPath);
+#else
+        std::cerr << "Client mode is only supported on Linux" << std::endl;
+        return 1;
+#endif
+    }
 
-    todoListPaths.reserve(listDirPathBuffer.size());
-    for(auto& path : listDirPathBuffer)
-        todoListPaths.emplace_back(path);
-    listDirPathBuffer.clear();
+    // Shared with every other instance using the same data directory.
+    Todo::Catalog catalog(listDirPath);
+    Todo::Archive archive("data/archive.seg");
+
+    if(mode == "--serve")
+    {
+#ifdef __linux__
+        installSignalHandlers();
+        Todo::Reminders reminders("data/reminders.bin");
+        reminders.load();
+        Todo::Server server(socketPath, dirPath, catalog, archive, reminders);
+        if(!server.listen())
+            return 1;
+        std::cout << "Serving on " << socketPath << std::endl;
+        server.run(signalPipe[0]);
+        catalog.save();
+        return signalled;
+#else
+        std::cerr << "Daemon mode is only supported on Linux" << std::endl;
+        return 1;
+#endif
+    }
+    else if(mode == "--import" || mode == "--export")
+        return runBulk(mode, dirPath, catalog, archive, argc, argv);
+    else if(mode == "--archive")
+        return runArchive(catalog, archive, argc, argv);
+    else if(!mode.empty())
+    {
+        std::cerr << "Unknown option[" << mode << "]\nUse: TodoApp [--serve [socket] | --client [socket]"
+                     " | --import [list] [file] | --export [list] [file] | --archive [days]]" << std::endl;
+        return 1;
+    }
 
     std::string menuCommands("Commands: exit"
                              " list"
@@ -118,168 +357,169 @@ int main() {
                              " open [name]");
 
     std::string listCommands("Commands: add [description]"
-                             " done [index]"
+                             " add <<[END]"
+                             " insert [index] [description]"
+                             " done [indices]"
+                             " undone [indices]"
+                             " del [index]"
+                             " move [index] [index]"
+                             " find [terms]"
+                             " due [index] [when] [every interval]"
+                             " undue [index]"
+                             " import [file]"
+                             " export [file]"
                              " close"
                              " exit");
 
-    printCommands(menuCommands);
+    installSignalHandlers();
+    Todo::Watcher watcher;
+    watcher.watch(listDirPath);
 
-    while(true)
-    {
-        auto inputBuffer = getUserInput();
-        std::string command = getNext(inputBuffer);
+    Todo::Reminders reminders("data/reminders.bin");
+    reminders.load();
 
-        if(command == "exit")
-            break;
-        else if(command == "list")
-        {
-            clearConsole();
-            printCommands(menuCommands);
+    // The terminal runs the same commands as daemon clients; it redraws the list itself instead of
+    // getting changed entries echoed.
+    Todo::HotLists lists;
+    Todo::Session session(dirPath, catalog, archive, reminders, lists, false);
 
-            std::size_t count = 1;
-            for(auto& path : todoListPaths)
-            {
-                std::string name = path.filename().string();
-                name.erase(name.end() - 4, name.end());
-                std::cout << count++ << " : " << name << std::endl;
-            }
-        }
-        else if(command == "add")
+    auto onChange = [&](const std::vector<fs::path>& changed)
+    {
+        Todo::List* openList = session.openList();
+        for(auto& path : changed)
         {
-            clearConsole();
-            printCommands(menuCommands);
+            if(Todo::Watcher::samePath(path, listDirPath))
+                catalog.mergeFromFile();
+            else if(openList && (Todo::Watcher::samePath(path, openList->path())
+                                 || Todo::Watcher::samePath(path, openList->journalPath())))
+                refreshList(session.openName(), listCommands, *openList, openList->reload());
+        }
+    };
 
-            command = getNext(inputBuffer);
-            if(command.empty())
+    // Entries are looked up per list, so each list with due reminders is read once per batch.
+    auto onDue = [&](std::vector<Todo::Reminder>& due)
+    {
+        std::sort(due.begin(), due.end(), [](const Todo::Reminder& a, const Todo::Reminder& b) { return a.mList < b.mList; });
+        Todo::List* openList = session.openList();
+        Todo::List other;
+        for(std::size_t i = 0; i < due.size(); i++)
+        {
+            const std::string& listPath = reminders.listPath(due[i]);
+            const Todo::List* list = openList;
+            if(!openList || openList->path().lexically_normal().generic_string() != listPath)
             {
-                std::cerr << "No name for the todo list was given!\nUse of add: add [name]" << std::endl;
-                continue;
+                // A reminder coming due brings an archived list back, like opening it would.
+                if((i == 0 || due[i].mList != due[i - 1].mList)
+                   && (!archive.promote(catalog, listPath) || !other.load(listPath)))
+                    other.release();
+                list = &other;
             }
 
-            fs::path newPath = addNewTodoList(dirPath, command);
-            if(newPath.empty())
-                continue;
-            todoListPaths.emplace_back(newPath);
-        }
-        else if(command == "open")
-        {
-            clearConsole();
-            std::string name = getNext(inputBuffer);
-            if(name.empty())
+            std::uint32_t slot = list->slotOf(due[i].mEntry);
+            if(slot == Todo::OrderTree::kNil || list->store().done(slot))
             {
-                std::cerr << "Failed to open todo list with name[" << name << "]" << std::endl;
+                // Deleted or finished in the meantime.
+                reminders.cancel(listPath, due[i].mEntry);
                 continue;
             }
+            std::string name = fs::path(listPath).stem().string();
+            std::cout << "Reminder: " << name << " - " << list->store().text(slot) << " (due "
+                      << Todo::Reminders::formatTime(due[i].mDue) << ")" << std::endl;
+        }
+        reminders.flush();
+    };
 
-            currentTodoList = dirPath;
-            currentTodoList += name;
-            currentTodoList += ".txt";
+    Todo::Reactor reactor;
+    Todo::LineReader input(reactor, 0);
 
-            std::vector<std::string> entries;
-            if(!FileHandler::GetLinesFromFile(currentTodoList, entries))
-            {
-                clearConsole();
-                printCommands(menuCommands);
-                std::cerr << "Failed to open list with name[" << name << "]. This list doesn't exist" << std::endl;
-                continue;
-            }
+    // The command loop is a coroutine on the reactor, next to the file watcher, so waiting for input
+    // never keeps reloads from happening.
+    auto commandLoop = [&]() -> Todo::Task<void>
+    {
+        printCommands(menuCommands);
 
-            std::cout << "Todo list: " << name << std::endl;
-            printCommands(listCommands);
-            printEntries(entries);
+        std::string out;
+        fs::path watched;
+        while(!session.closed())
+        {
+            auto line = co_await input.readLine();
+            if(signalled)
+                break;
 
-            std::size_t count = entries.size() + 1;
-            bool exit = false;
+            // End of input finishes a pending add <<END block, then behaves like the exit command.
+            bool collecting = !session.terminator().empty();
+            std::string request = line ? std::move(*line) : collecting ? session.terminator() : std::string("exit");
+            std::string inputBuffer = request;
+            std::string command = getNext(inputBuffer);
 
-            while(true)
-            {
-                inputBuffer = getUserInput();
-                command = getNext(inputBuffer);
+            out.clear();
+            bool ok = session.execute(request, out);
+            if(!session.terminator().empty())
+                continue;
 
-                if(command == "close")
-                    break;
-                else if(command == "add")
-                {
-                    if(inputBuffer.empty())
-                    {
-                        std::cerr << "Failed to add an entry!\nUse of add: add [description]" << std::endl;
-                        continue;
-                    }
-
-                    std::string entry = std::to_string(count++);
-                    entry += "\t[ ] - " + inputBuffer + "\n";
-
-                    entries.emplace_back(entry);
-                    FileHandler::WriteToFile(currentTodoList, entries.at(entries.size() -1), std::ios::app);
-
-                    clearConsole();
-                    std::cout << "Todo list: " << name << std::endl;
-                    printCommands(listCommands);
-                    printEntries(entries);
-                }
-                else if(command == "done")
-                {
-                    if(inputBuffer.empty())
-                    {
-                        std::cerr << "Failed to add an entry!\nUse of add: add [description]" << std::endl;
-                        continue;
-                    }
-
-                    int index;
-                    std::istringstream iss(inputBuffer);
-                    iss >> index;
-                    index -= 1;
-
-                    if(index >= 0 && index <= entries.size())
-                    {
-                        entries.at(index).replace(entries.at(index).find_first_of('['), 3, "[X]");
-                    }
-                    else
-                        std::cerr << "failed do mark entry as done! no entry with index[" << index << "]" << std::endl;
-
-                    std::string out;
-                    for(auto& e : entries)
-                    {
-                        if(e.ends_with('\n'))
-                            out += e;
-                        else
-                            out += e + '\n';
-                    }
-
-                    FileHandler::WriteToFile(currentTodoList, out);
-
-                    clearConsole();
-                    std::cout << "Todo list: " << name << std::endl;
-                    printCommands(listCommands);
-                    printEntries(entries);
-                }
-                else if(command == "exit")
+            // Files of the open list are watched for changes by other processes.
+            Todo::List* list = session.openList();
+            fs::path path = list ? list->path() : fs::path();
+            if(path != watched)
+            {
+                if(!watched.empty())
                 {
-                    exit = true;
-                    break;
+                    watcher.unwatch(watched);
+                    watcher.unwatch(fs::path(watched).replace_extension(".journal"));
                 }
-                else
+                if(list)
                 {
-                    std::cout << "Unknown command["<< command << "]\n"<< listCommands << std::endl;
+                    watcher.watch(list->path());
+                    watcher.watch(list->journalPath());
                 }
+                watched = path;
             }
-            if(exit)
+            if(session.closed())
                 break;
-            clearConsole();
-            printCommands(menuCommands);
-        }
-        else
-        {
-            clearConsole();
-            std::cout << "Unknown command["<< command << "]\n"<< menuCommands << std::endl;
+
+            std::ostream& stream = ok ? std::cout : std::cerr;
+            if(!list)
+            {
+                clearConsole();
+                printCommands(menuCommands);
+                stream << out << std::flush;
+            }
+            else if(ok && !collecting && (command == "find" || command == "filter"))
+            {
+                clearConsole();
+                std::cout << listHeader(session.openName(), *list) << " - " << session.matches().size() << " found" << std::endl;
+                printCommands(listCommands);
+                std::cout << out << std::flush;
+            }
+            else
+            {
+                printList(session.openName(), listCommands, *list);
+                stream << out << std::flush;
+            }
         }
-    }
 
-    std::string outString;
-    for(auto& path : todoListPaths)
-        outString += path.string() + "\n";
+        reactor.stop();
+    };
+
+    reactor.spawn(watchSignals(reactor, signalPipe[0]));
+    reactor.spawn(watchFiles(reactor, watcher, onChange));
+    reactor.spawn(watchReminders(reactor, reminders, onDue));
+    reactor.spawn(commandLoop());
+    try
+    {
+        reactor.run();
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << "Failed to keep running : " << e.what() << std::endl;
+        catalog.save();
+        return 1;
+    }
 
-    FileHandler::WriteToFile(listDirPath, outString);
+    catalog.save();
+    if(signalled)
+        return signalled;
+    reminders.compact();
 
     return 0;
 }
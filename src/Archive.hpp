@@ -0,0 +1,530 @@
+#ifndef ARCHIVE_HPP
+#define ARCHIVE_HPP
+
+#include "../dependencies/FileHandler.hpp"
+#include "Catalog.hpp"
+#include "FileLock.hpp"
+#include "Lz.hpp"
+#include "TodoList.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Todo
+{
+    // Cold storage for lists nobody opened in a while. pack() compresses a list's .txt and .meta into
+    // data/archive.seg and removes the files; promote() restores them when the list is opened again.
+    // The segment starts with a header pointing at an offset table at its end:
+    //
+    //     header  "TDA2", u32 entries, u64 table offset, u64 table size, u64 reserved
+    //     data    one Lz framed payload per list: the .txt followed by the .meta
+    //     table   per list: TableEntry followed by the list path
+    //
+    // Packing appends payloads and a new table behind the old one and only then points the header at
+    // it, so a crash leaves the previous table intact. Promoting just clears the entry's live flag in
+    // place; space of promoted lists is reclaimed when packing finds the segment mostly dead. Restoring
+    // writes next to the list and renames, so the list's files either appear complete or not at all.
+    // The tier of every list is recorded in the Catalog, so listing lists never has to look in here.
+    class Archive
+    {
+    private:
+        static constexpr char kMagic[4] = {'T', 'D', 'A', '2'};
+
+        struct Header
+        {
+            char mMagic[4];
+            std::uint32_t mEntries;
+            std::uint64_t mTableOffset;
+            std::uint64_t mTableSize;
+            std::uint64_t mReserved;
+        };
+        static_assert(sizeof(Header) == 32);
+
+        struct TableEntry
+        {
+            std::uint64_t mOffset;
+            std::uint64_t mStored;
+            std::uint64_t mTextSize;
+            std::uint64_t mMetaSize;
+            std::int64_t mPacked;
+            std::uint16_t mPathLength;
+            std::uint8_t mLive;
+            std::uint8_t mReserved[5];
+        };
+        static_assert(sizeof(TableEntry) == 48);
+
+        struct Item
+        {
+            TableEntry mEntry;
+            std::string mPath;
+            std::uint64_t mTablePosition; // where mEntry sits in the file, for clearing mLive
+        };
+
+        // A list packed in this run whose files are removed once the new table is in place.
+        struct Candidate
+        {
+            fs::path mPath;
+            std::uintmax_t mTextSize;
+            fs::file_time_type mWriteTime;
+            std::size_t mItem;
+        };
+
+        fs::path mPath;
+        fs::path mLockPath;
+        std::vector<Item> mItems;
+        std::unordered_map<std::string, std::size_t> mIndex; // list path -> its newest item
+        Header mHeader;                                      // the table mItems was read from
+        std::string mBuffer;
+        std::string mPayload;
+
+        static std::string normalize(const fs::path& list)
+        {
+            return list.lexically_normal().generic_string();
+        }
+
+        static fs::path sibling(const fs::path& list, const char* extension)
+        {
+            return fs::path(list).replace_extension(extension);
+        }
+
+        // Newest change to any of the list's files. Opening a list touches its journal, see markUsed().
+        static fs::file_time_type lastUsed(const fs::path& list)
+        {
+            fs::file_time_type newest = fs::file_time_type::min();
+            for(const fs::path& file : {list, sibling(list, ".journal"), sibling(list, ".meta")})
+            {
+                std::error_code ec;
+                fs::file_time_type time = fs::last_write_time(file, ec);
+                if(!ec)
+                    newest = std::max(newest, time);
+            }
+            return newest;
+        }
+
+        static bool readFile(const fs::path& path, std::string& out)
+        {
+            out.clear();
+            std::ifstream inStream(path, std::ios::binary);
+            if(!inStream.is_open())
+                return false;
+            std::error_code ec;
+            out.resize(static_cast<std::size_t>(fs::file_size(path, ec)));
+            inStream.read(out.data(), static_cast<std::streamsize>(out.size()));
+            out.resize(static_cast<std::size_t>(inStream.gcount()));
+            return true;
+        }
+
+        // Reads header and table into mItems. An empty file is an empty archive. The table is only read
+        // again when the header points at a different one; live flags other instances cleared since
+        // are picked up then too, which promote() doesn't depend on.
+        bool readTable(std::fstream& file, const bool& force = false)
+        {
+            std::error_code ec;
+            std::uintmax_t size = fs::file_size(mPath, ec);
+            if(ec || size == 0)
+            {
+                mItems.clear();
+                mIndex.clear();
+                mHeader = Header{};
+                return true;
+            }
+
+            Header header{};
+            file.seekg(0, std::ios::beg);
+            if(!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || std::memcmp(header.mMagic, kMagic, sizeof(kMagic)) != 0
+               || header.mTableOffset + header.mTableSize > size)
+            {
+                std::cerr << "Failed to read archive: " << mPath << " is damaged" << std::endl;
+                return false;
+            }
+            if(!force && std::memcmp(&header, &mHeader, sizeof(header)) == 0)
+                return true;
+
+            mItems.clear();
+            mIndex.clear();
+            mHeader = Header{};
+            mBuffer.resize(header.mTableSize);
+            file.seekg(static_cast<std::streamoff>(header.mTableOffset), std::ios::beg);
+            if(!file.read(mBuffer.data(), static_cast<std::streamsize>(mBuffer.size())))
+                return false;
+
+            std::size_t offset = 0;
+            while(offset + sizeof(TableEntry) <= mBuffer.size() && mItems.size() < header.mEntries)
+            {
+                Item item{};
+                std::memcpy(&item.mEntry, mBuffer.data() + offset, sizeof(TableEntry));
+                if(offset + sizeof(TableEntry) + item.mEntry.mPathLength > mBuffer.size())
+                    break;
+                item.mPath.assign(mBuffer, offset + sizeof(TableEntry), item.mEntry.mPathLength);
+                item.mTablePosition = header.mTableOffset + offset;
+                offset += sizeof(TableEntry) + item.mEntry.mPathLength;
+                if(item.mEntry.mLive)
+                    mIndex[item.mPath] = mItems.size();
+                mItems.push_back(std::move(item));
+            }
+            mHeader = header;
+            return true;
+        }
+
+        // Appends a table of the live items at end and points the header at it.
+        bool writeTable(std::fstream& file, const std::uint64_t& end)
+        {
+            mBuffer.clear();
+            std::uint32_t entries = 0;
+            for(Item& item : mItems)
+            {
+                if(!item.mEntry.mLive)
+                    continue;
+                item.mTablePosition = end + mBuffer.size();
+                mBuffer.append(reinterpret_cast<const char*>(&item.mEntry), sizeof(TableEntry));
+                mBuffer += item.mPath;
+                entries++;
+            }
+
+            Header header{};
+            std::memcpy(header.mMagic, kMagic, sizeof(kMagic));
+            header.mEntries = entries;
+            header.mTableOffset = end;
+            header.mTableSize = mBuffer.size();
+
+            file.seekp(static_cast<std::streamoff>(end), std::ios::beg);
+            file.write(mBuffer.data(), static_cast<std::streamsize>(mBuffer.size()));
+            file.flush();
+            file.seekp(0, std::ios::beg);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.flush();
+            if(file.fail())
+            {
+                std::cerr << "Failed to write to file: " << mPath << " : " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            mHeader = header;
+            return true;
+        }
+
+        bool clearLive(std::fstream& file, Item& item)
+        {
+            item.mEntry.mLive = 0;
+            file.seekp(static_cast<std::streamoff>(item.mTablePosition + offsetof(TableEntry, mLive)), std::ios::beg);
+            file.put(0);
+            file.flush();
+            return !file.fail();
+        }
+
+        // Rewrites the segment with only the live payloads once most of it belongs to promoted lists.
+        bool compactLocked(std::fstream& file)
+        {
+            std::uint64_t live = 0;
+            for(const Item& item : mItems)
+                if(item.mEntry.mLive)
+                    live += item.mEntry.mStored;
+
+            std::error_code ec;
+            std::uintmax_t size = fs::file_size(mPath, ec);
+            if(ec || size <= 2 * live + (1 << 20))
+                return true;
+
+            fs::path temp = mPath;
+            temp += ".tmp";
+            {
+                std::fstream out(temp, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+                if(!out.is_open())
+                {
+                    std::cerr << "Failed to open: " << temp << " : " << std::strerror(errno) << std::endl;
+                    return false;
+                }
+
+                std::uint64_t end = sizeof(Header);
+                out.seekp(static_cast<std::streamoff>(end), std::ios::beg);
+                for(Item& item : mItems)
+                {
+                    if(!item.mEntry.mLive)
+                        continue;
+                    mPayload.resize(item.mEntry.mStored);
+                    file.seekg(static_cast<std::streamoff>(item.mEntry.mOffset), std::ios::beg);
+                    if(!file.read(mPayload.data(), static_cast<std::streamsize>(mPayload.size())))
+                        return false;
+                    out.write(mPayload.data(), static_cast<std::streamsize>(mPayload.size()));
+                    item.mEntry.mOffset = end;
+                    end += item.mEntry.mStored;
+                }
+                if(!writeTable(out, end))
+                    return false;
+            }
+
+            file.close();
+            fs::rename(temp, mPath, ec);
+            if(ec)
+            {
+                std::cerr << "Failed to replace: " << mPath << " : " << ec.message() << std::endl;
+                return false;
+            }
+            file.open(mPath, std::ios::in | std::ios::out | std::ios::binary);
+            return readTable(file, true);
+        }
+
+        // Folds the journal into the snapshot first, so the archive holds just the .txt and .meta.
+        bool packOne(std::fstream& file, const fs::path& list, std::uint64_t& end, std::vector<Candidate>& candidates)
+        {
+            std::error_code ec;
+            if(fs::file_size(sibling(list, ".journal"), ec) > 0 && !ec)
+            {
+                List loaded;
+                if(!loaded.load(list) || !loaded.compact())
+                    return false;
+            }
+
+            Candidate candidate{list, fs::file_size(list, ec), fs::last_write_time(list, ec), mItems.size()};
+            if(ec || !readFile(list, mBuffer))
+                return false;
+
+            TableEntry entry{};
+            entry.mTextSize = mBuffer.size();
+            mPayload.clear();
+            std::string meta;
+            readFile(sibling(list, ".meta"), meta);
+            entry.mMetaSize = meta.size();
+            mBuffer += meta;
+            Lz::compress(mBuffer, mPayload);
+
+            file.seekp(static_cast<std::streamoff>(end), std::ios::beg);
+            file.write(mPayload.data(), static_cast<std::streamsize>(mPayload.size()));
+            if(file.fail())
+                return false;
+
+            // An older copy of the list, left behind by a pack that didn't finish, is superseded.
+            std::string path = normalize(list);
+            auto [it, inserted] = mIndex.try_emplace(path, mItems.size());
+            if(!inserted)
+            {
+                mItems[it->second].mEntry.mLive = 0;
+                it->second = mItems.size();
+            }
+
+            entry.mOffset = end;
+            entry.mStored = mPayload.size();
+            entry.mPacked = std::chrono::duration_cast<std::chrono::seconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            entry.mPathLength = static_cast<std::uint16_t>(path.size());
+            entry.mLive = 1;
+            mItems.push_back(Item{entry, path, 0});
+            candidates.push_back(std::move(candidate));
+            end += mPayload.size();
+            return true;
+        }
+
+        // Decodes the payload block by block, splitting it into the .txt and the .meta. Both are written
+        // to temporary files that replace the real ones only once they are complete, the .txt last, so
+        // a restore that fails halfway leaves nothing a later promote() could mistake for the list.
+        bool restore(std::fstream& file, const Item& item, const fs::path& list)
+        {
+            mPayload.resize(item.mEntry.mStored);
+            file.seekg(static_cast<std::streamoff>(item.mEntry.mOffset), std::ios::beg);
+            if(!file.read(mPayload.data(), static_cast<std::streamsize>(mPayload.size())))
+                return false;
+
+            fs::path textTemp = list;
+            textTemp += ".tmp";
+            fs::path metaTemp = sibling(list, ".meta");
+            metaTemp += ".tmp";
+            auto fail = [&]()
+            {
+                std::error_code ec;
+                fs::remove(textTemp, ec);
+                fs::remove(metaTemp, ec);
+                return false;
+            };
+
+            std::ofstream text(textTemp, std::ios::binary | std::ios::trunc);
+            std::ofstream meta;
+            if(item.mEntry.mMetaSize > 0)
+                meta.open(metaTemp, std::ios::binary | std::ios::trunc);
+            if(!text.is_open() || (item.mEntry.mMetaSize > 0 && !meta.is_open()))
+            {
+                std::cerr << "Failed to open: " << textTemp << " : " << std::strerror(errno) << std::endl;
+                return fail();
+            }
+
+            std::string_view input(mPayload);
+            std::uint64_t decoded = 0;
+            while(!input.empty())
+            {
+                mBuffer.clear();
+                if(!Lz::decodeBlock(input, mBuffer))
+                {
+                    std::cerr << "Failed to restore: " << list << " : archive is damaged" << std::endl;
+                    return fail();
+                }
+
+                std::string_view block(mBuffer);
+                if(decoded < item.mEntry.mTextSize)
+                {
+                    std::size_t textPart = static_cast<std::size_t>(std::min<std::uint64_t>(block.size(), item.mEntry.mTextSize - decoded));
+                    text.write(block.data(), static_cast<std::streamsize>(textPart));
+                    block.remove_prefix(textPart);
+                    decoded += textPart;
+                }
+                meta.write(block.data(), static_cast<std::streamsize>(block.size()));
+                decoded += block.size();
+            }
+            text.close();
+            if(meta.is_open())
+                meta.close();
+
+            std::error_code ec;
+            bool complete = decoded == item.mEntry.mTextSize + item.mEntry.mMetaSize && !text.fail() && !meta.fail()
+                            && fs::file_size(textTemp, ec) == item.mEntry.mTextSize && !ec;
+            if(!complete)
+            {
+                std::cerr << "Failed to restore: " << list << " : " << std::strerror(errno) << std::endl;
+                return fail();
+            }
+
+            if(item.mEntry.mMetaSize > 0)
+                fs::rename(metaTemp, sibling(list, ".meta"), ec);
+            if(!ec)
+                fs::rename(textTemp, list, ec);
+            if(ec)
+            {
+                std::cerr << "Failed to restore: " << list << " : " << ec.message() << std::endl;
+                return fail();
+            }
+            return true;
+        }
+
+    public:
+        [[maybe_unused]] explicit Archive(const fs::path& path)
+        : mPath(path), mLockPath(fs::path(path).replace_extension(".lock")), mItems(), mIndex(), mHeader(), mBuffer(),
+          mPayload()
+        {}
+
+        // Records that a list was just opened, which keeps it out of the next pack().
+        [[maybe_unused]] static void markUsed(const fs::path& list)
+        {
+            std::error_code ec;
+            fs::last_write_time(sibling(list, ".journal"), fs::file_time_type::clock::now(), ec);
+        }
+
+        // Packs every hot list of the catalog that wasn't used for age and marks it cold. Lists that
+        // change while they are being packed stay hot.
+        [[maybe_unused]] bool pack(Catalog& catalog, const std::chrono::seconds& age, std::size_t& packed)
+        {
+            packed = 0;
+            FileLock lock(mLockPath, LockMode::exclusive);
+            if(lock.failed() || !FileHandler::CreateFile(mPath))
+                return false;
+            std::fstream file(mPath, std::ios::in | std::ios::out | std::ios::binary);
+            if(!file.is_open())
+            {
+                std::cerr << "Failed to open: " << mPath << " : " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            if(!readTable(file, true) || !compactLocked(file))
+                return false;
+
+            std::error_code ec;
+            std::uint64_t end = std::max<std::uint64_t>(fs::file_size(mPath, ec), sizeof(Header));
+            auto cutoff = fs::file_time_type::clock::now() - age;
+            std::vector<Candidate> candidates;
+            for(const Listing& listing : catalog.listings())
+            {
+                if(listing.mTier != Tier::hot || !fs::exists(listing.mPath) || lastUsed(listing.mPath) > cutoff
+                   || normalize(listing.mPath).size() > UINT16_MAX)
+                    continue;
+                if(!packOne(file, listing.mPath, end, candidates))
+                    std::cerr << "Failed to pack list: " << listing.mPath << std::endl;
+            }
+            if(candidates.empty())
+                return true;
+            if(!writeTable(file, end))
+                return false;
+
+            // The archive now holds a copy. The lists are marked cold before their files go, so the
+            // catalog never points at files that are missing; a cold list whose files are still there
+            // is simply treated as hot again by promote().
+            std::vector<fs::path> paths;
+            for(const Candidate& candidate : candidates)
+                paths.push_back(candidate.mPath);
+            catalog.setTier(paths, Tier::cold);
+
+            // Drop the files unless someone wrote to the list meanwhile.
+            paths.clear();
+            for(const Candidate& candidate : candidates)
+            {
+                fs::path journal = sibling(candidate.mPath, ".journal");
+                FileLock journalLock(journal, LockMode::exclusive);
+                std::error_code sizeError;
+                std::error_code timeError;
+                std::error_code journalError;
+                // Without the lock a writer could be mid-change, so the files stay.
+                bool unchanged = !journalLock.failed() && fs::file_size(candidate.mPath, sizeError) == candidate.mTextSize
+                                 && fs::last_write_time(candidate.mPath, timeError) == candidate.mWriteTime
+                                 && fs::file_size(journal, journalError) == 0 && !sizeError && !timeError;
+                if(!unchanged)
+                {
+                    clearLive(file, mItems[candidate.mItem]);
+                    paths.push_back(candidate.mPath);
+                    continue;
+                }
+
+                fs::remove(candidate.mPath, ec);
+                fs::remove(sibling(candidate.mPath, ".meta"), ec);
+                fs::remove(journal, ec);
+                packed++;
+            }
+            catalog.setTier(paths, Tier::hot);
+            catalog.save();
+            return true;
+        }
+
+        // Makes sure an archived list is back in todo_lists/ before it is opened, and marks it used.
+        // Returns false if the list is cold but couldn't be restored.
+        [[maybe_unused]] bool promote(Catalog& catalog, const fs::path& list)
+        {
+            if(catalog.tier(list) == Tier::cold)
+            {
+                FileLock lock(mLockPath, LockMode::exclusive);
+                std::fstream file(mPath, std::ios::in | std::ios::out | std::ios::binary);
+                if(lock.failed() || !file.is_open() || !readTable(file))
+                    return false;
+
+                // Files that are already there, because another instance promoted the list or packing
+                // didn't get to remove them, are newer than the archived copy.
+                bool present = fs::exists(list);
+                auto it = mIndex.find(normalize(list));
+                if(it != mIndex.end() && mItems[it->second].mEntry.mLive)
+                {
+                    Item& item = mItems[it->second];
+                    if((!present && !restore(file, item, list)) || !clearLive(file, item))
+                        return false;
+                }
+
+                // paths.txt catches up with the next save; until then promote() sees the files and
+                // treats the list as hot anyway.
+                if(!fs::exists(list))
+                    return false;
+                catalog.setTier(list, Tier::hot);
+            }
+            markUsed(list);
+            return true;
+        }
+
+        // Number of lists in the archive, from the offset table alone.
+        [[maybe_unused]] std::size_t size()
+        {
+            FileLock lock(mLockPath, LockMode::shared);
+            std::fstream file(mPath, std::ios::in | std::ios::binary);
+            if(!file.is_open() || !readTable(file))
+                return 0;
+            std::size_t count = 0;
+            for(const Item& item : mItems)
+                count += item.mEntry.mLive;
+            return count;
+        }
+    };
+}
+#endif // ARCHIVE_HPP
@@ -0,0 +1,719 @@
+#ifndef BULK_IO_HPP
+#define BULK_IO_HPP
+
+#include "Query.hpp"
+#include "TodoList.hpp"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Todo
+{
+    // Formats understood by import and export:
+    //
+    //     .txt     todo.txt: "x " marks done entries, a leading YYYY-MM-DD is the creation day
+    //     .csv     columns id, done, created, text with a header row; files without one are a
+    //              single column of descriptions
+    //     .jsonl   one object per line: {"id":1,"done":false,"created":1760000000,"text":"..."}
+    enum class Format
+    {
+        todoTxt,
+        csv,
+        jsonLines
+    };
+
+    [[maybe_unused]] inline bool formatOf(const fs::path& file, Format& format)
+    {
+        std::string extension = file.extension().string();
+        if(extension == ".txt")
+            format = Format::todoTxt;
+        else if(extension == ".csv")
+            format = Format::csv;
+        else if(extension == ".jsonl" || extension == ".ndjson")
+            format = Format::jsonLines;
+        else
+            return false;
+        return true;
+    }
+
+    // Streams entries from a file into a list. The input is read in fixed-size chunks cut at record
+    // boundaries; a batch of chunks, one per hardware thread, is parsed in parallel, numbered, formatted
+    // in parallel and appended to the list file and its meta file in order. Buffers belong to the
+    // chunks and are reused from batch to batch, so memory stays at a few chunks per thread no matter
+    // how large the input is.
+    class Importer
+    {
+    private:
+        static constexpr std::size_t kChunkSize = 1 << 20;
+        static constexpr unsigned kMaxThreads = 8;
+
+        enum Column
+        {
+            columnId,
+            columnDone,
+            columnCreated,
+            columnText,
+            columnCount
+        };
+
+        struct Row
+        {
+            std::int64_t mCreated;
+            std::uint32_t mOffset;
+            std::uint32_t mLength;
+            bool mDone;
+        };
+
+        struct Chunk
+        {
+            std::string mInput;
+            std::string mText;
+            std::vector<Row> mRows;
+            std::string mOut;
+            std::string mMeta;
+            std::size_t mSkipped = 0;
+        };
+
+        Format mFormat;
+        std::int64_t mNow;
+        // Field index of each column in a CSV record, -1 if the file doesn't have it.
+        std::array<int, columnCount> mColumns;
+        std::vector<Chunk> mChunks;
+
+        // Calls fn(index) for the first count chunks, each on its own thread.
+        template<typename F>
+        static void parallel(const std::size_t& count, F&& fn)
+        {
+            std::vector<std::thread> workers;
+            workers.reserve(count);
+            for(std::size_t i = 1; i < count; i++)
+                workers.emplace_back([&fn, i]() { fn(i); });
+            if(count > 0)
+                fn(std::size_t(0));
+            for(auto& worker : workers)
+                worker.join();
+        }
+
+        // Where the last complete record in input ends, or npos. CSV fields may contain quoted newlines.
+        std::size_t recordEnd(std::string_view input) const
+        {
+            if(mFormat != Format::csv)
+            {
+                std::size_t newline = input.rfind('\n');
+                return newline == std::string_view::npos ? newline : newline + 1;
+            }
+
+            std::size_t end = std::string_view::npos;
+            bool quoted = false;
+            for(std::size_t i = 0; i < input.size(); i++)
+            {
+                if(input[i] == '"')
+                    quoted = !quoted;
+                else if(input[i] == '\n' && !quoted)
+                    end = i + 1;
+            }
+            return end;
+        }
+
+        // Entries are single lines, so line breaks inside a description become spaces.
+        static void appendText(std::string& out, std::string_view text)
+        {
+            std::size_t begin = out.size();
+            out += text;
+            std::replace_if(out.begin() + static_cast<std::ptrdiff_t>(begin), out.end(),
+                            [](char c) { return c == '\n' || c == '\r'; }, ' ');
+        }
+
+        static bool isTrue(std::string_view value)
+        {
+            return value == "1" || value == "true" || value == "x" || value == "X" || value == "yes";
+        }
+
+        // Seconds since the epoch or YYYY-MM-DD.
+        bool parseCreated(std::string_view value, std::int64_t& created) const
+        {
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), created);
+            if(ec == std::errc() && ptr == value.data() + value.size())
+                return true;
+            return Query::parseDay(value, created);
+        }
+
+        void pushRow(Chunk& chunk, const std::size_t& textBegin, const bool& done, const std::int64_t& created)
+        {
+            chunk.mRows.push_back(Row{created, static_cast<std::uint32_t>(textBegin),
+                                      static_cast<std::uint32_t>(chunk.mText.size() - textBegin), done});
+        }
+
+        void parseTodoTxt(Chunk& chunk, std::string_view line)
+        {
+            bool done = false;
+            std::int64_t created = mNow;
+            std::int64_t day = 0;
+            if(line.starts_with("x "))
+            {
+                done = true;
+                line.remove_prefix(2);
+                // A completed task may carry its completion day before the creation day.
+                if(line.size() > 10 && line[10] == ' ' && Query::parseDay(line.substr(0, 10), day))
+                    line.remove_prefix(11);
+            }
+
+            // The priority stays part of the description; the creation day follows it.
+            std::string_view priority;
+            if(line.size() > 4 && line[0] == '(' && line[2] == ')' && line[3] == ' ')
+            {
+                priority = line.substr(0, 4);
+                line.remove_prefix(4);
+            }
+            if(line.size() > 10 && line[10] == ' ' && Query::parseDay(line.substr(0, 10), day))
+            {
+                created = day;
+                line.remove_prefix(11);
+            }
+
+            std::size_t begin = chunk.mText.size();
+            chunk.mText += priority;
+            appendText(chunk.mText, line);
+            pushRow(chunk, begin, done, created);
+        }
+
+        // Splits the next field off record. Quotes are removed; escaped quotes stay doubled and are
+        // collapsed by appendCsvText().
+        static std::string_view nextCsvField(std::string_view& record, bool& quoted)
+        {
+            quoted = !record.empty() && record.front() == '"';
+            if(!quoted)
+            {
+                std::size_t comma = record.find(',');
+                std::string_view field = record.substr(0, comma);
+                record.remove_prefix(comma == std::string_view::npos ? record.size() : comma + 1);
+                return field;
+            }
+
+            std::size_t i = 1;
+            while(i < record.size())
+            {
+                if(record[i] == '"' && i + 1 < record.size() && record[i + 1] == '"')
+                    i += 2;
+                else if(record[i] == '"')
+                    break;
+                else
+                    i++;
+            }
+            std::string_view field = record.substr(1, i - 1);
+            std::size_t comma = record.find(',', i);
+            record.remove_prefix(comma == std::string_view::npos ? record.size() : comma + 1);
+            return field;
+        }
+
+        static void appendCsvText(std::string& out, std::string_view field, const bool& quoted)
+        {
+            if(!quoted)
+            {
+                appendText(out, field);
+                return;
+            }
+            std::size_t quote;
+            while((quote = field.find("\"\"")) != std::string_view::npos)
+            {
+                appendText(out, field.substr(0, quote + 1));
+                field.remove_prefix(quote + 2);
+            }
+            appendText(out, field);
+        }
+
+        void parseCsv(Chunk& chunk, std::string_view record)
+        {
+            bool done = false;
+            std::int64_t created = mNow;
+            std::size_t begin = chunk.mText.size();
+            bool hasText = false;
+
+            for(int field = 0; !record.empty() || field == 0; field++)
+            {
+                bool quoted = false;
+                std::string_view value = nextCsvField(record, quoted);
+                if(field == mColumns[columnDone])
+                    done = isTrue(value);
+                else if(field == mColumns[columnCreated] && !value.empty() && !parseCreated(value, created))
+                    created = mNow;
+                else if(field == mColumns[columnText])
+                {
+                    appendCsvText(chunk.mText, value, quoted);
+                    hasText = true;
+                }
+            }
+
+            if(!hasText)
+            {
+                chunk.mSkipped++;
+                return;
+            }
+            pushRow(chunk, begin, done, created);
+        }
+
+        static void skipSpace(std::string_view& input)
+        {
+            while(!input.empty() && (input.front() == ' ' || input.front() == '\t'))
+                input.remove_prefix(1);
+        }
+
+        // Returns the raw contents of the string at the front of input, escapes included.
+        static bool nextJsonString(std::string_view& input, std::string_view& value)
+        {
+            if(input.empty() || input.front() != '"')
+                return false;
+            std::size_t i = 1;
+            while(i < input.size() && input[i] != '"')
+                i += input[i] == '\\' ? 2 : 1;
+            if(i >= input.size())
+                return false;
+            value = input.substr(1, i - 1);
+            input.remove_prefix(i + 1);
+            return true;
+        }
+
+        static void appendUtf8(std::string& out, const std::uint32_t& code)
+        {
+            if(code < 0x80)
+                out += static_cast<char>(code);
+            else if(code < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (code >> 6));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else if(code < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (code >> 12));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (code >> 18));
+                out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (code & 0x3F));
+            }
+        }
+
+        static bool readHex(std::string_view digits, std::uint32_t& code)
+        {
+            if(digits.size() < 4)
+                return false;
+            auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + 4, code, 16);
+            return ec == std::errc() && ptr == digits.data() + 4;
+        }
+
+        static void appendJsonText(std::string& out, std::string_view value)
+        {
+            std::size_t escape;
+            while((escape = value.find('\\')) != std::string_view::npos && escape + 1 < value.size())
+            {
+                appendText(out, value.substr(0, escape));
+                char c = value[escape + 1];
+                value.remove_prefix(escape + 2);
+                switch(c)
+                {
+                    case 'n':
+                    case 'r':
+                    case 't':
+                        out += ' ';
+                        break;
+                    case 'b':
+                    case 'f':
+                        break;
+                    case 'u':
+                    {
+                        std::uint32_t code = 0;
+                        if(!readHex(value, code))
+                            break;
+                        value.remove_prefix(4);
+                        std::uint32_t low = 0;
+                        if(code >= 0xD800 && code < 0xDC00 && value.starts_with("\\u") && readHex(value.substr(2), low)
+                           && low >= 0xDC00 && low < 0xE000)
+                        {
+                            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                            value.remove_prefix(6);
+                        }
+                        // Control characters, line breaks above all, would split the entry in the list file.
+                        if(code < 0x20)
+                            out += ' ';
+                        else
+                            appendUtf8(out, code);
+                        break;
+                    }
+                    default:
+                        out += c;
+                        break;
+                }
+            }
+            appendText(out, value);
+        }
+
+        // Flat objects only: string, number, true/false and null values.
+        void parseJsonLine(Chunk& chunk, std::string_view line)
+        {
+            bool done = false;
+            std::int64_t created = mNow;
+            std::size_t begin = chunk.mText.size();
+            bool hasText = false;
+
+            skipSpace(line);
+            if(line.empty() || line.front() != '{')
+            {
+                chunk.mSkipped++;
+                return;
+            }
+            line.remove_prefix(1);
+
+            while(true)
+            {
+                skipSpace(line);
+                if(!line.empty() && line.front() == '}')
+                    break;
+
+                std::string_view key;
+                if(!nextJsonString(line, key))
+                    break;
+                skipSpace(line);
+                if(line.empty() || line.front() != ':')
+                    break;
+                line.remove_prefix(1);
+                skipSpace(line);
+
+                std::string_view value;
+                bool isString = nextJsonString(line, value);
+                if(!isString)
+                {
+                    std::size_t end = line.find_first_of(",}");
+                    value = line.substr(0, end);
+                    while(!value.empty() && (value.back() == ' ' || value.back() == '\t'))
+                        value.remove_suffix(1);
+                    line.remove_prefix(end == std::string_view::npos ? line.size() : end);
+                }
+
+                if(key == "text" && isString && !hasText)
+                {
+                    appendJsonText(chunk.mText, value);
+                    hasText = true;
+                }
+                else if(key == "done")
+                    done = value == "true" || value == "1";
+                else if(key == "created" && !parseCreated(value, created))
+                    created = mNow;
+
+                skipSpace(line);
+                if(line.empty() || line.front() != ',')
+                    break;
+                line.remove_prefix(1);
+            }
+
+            if(!hasText)
+            {
+                chunk.mText.resize(begin);
+                chunk.mSkipped++;
+                return;
+            }
+            pushRow(chunk, begin, done, created);
+        }
+
+        void parse(Chunk& chunk)
+        {
+            chunk.mText.clear();
+            chunk.mRows.clear();
+            chunk.mSkipped = 0;
+
+            std::string_view input(chunk.mInput);
+            while(!input.empty())
+            {
+                std::size_t length = mFormat == Format::csv ? nextCsvRecord(input) : std::min(input.find('\n'), input.size() - 1) + 1;
+                std::string_view record = input.substr(0, length);
+                input.remove_prefix(length);
+                if(record.ends_with('\n'))
+                    record.remove_suffix(1);
+                if(record.ends_with('\r'))
+                    record.remove_suffix(1);
+                if(record.empty())
+                    continue;
+
+                if(mFormat == Format::todoTxt)
+                    parseTodoTxt(chunk, record);
+                else if(mFormat == Format::csv)
+                    parseCsv(chunk, record);
+                else
+                    parseJsonLine(chunk, record);
+            }
+        }
+
+        // Length of the first CSV record in input including its newline, respecting quotes.
+        static std::size_t nextCsvRecord(std::string_view input)
+        {
+            bool quoted = false;
+            for(std::size_t i = 0; i < input.size(); i++)
+            {
+                if(input[i] == '"')
+                    quoted = !quoted;
+                else if(input[i] == '\n' && !quoted)
+                    return i + 1;
+            }
+            return input.size();
+        }
+
+        static void format(Chunk& chunk, std::uint32_t id)
+        {
+            chunk.mOut.clear();
+            chunk.mMeta.clear();
+            char digits[24];
+            for(const Row& row : chunk.mRows)
+            {
+                auto [ptr, ec] = std::to_chars(digits, digits + sizeof(digits), id);
+                chunk.mOut.append(digits, ptr);
+                chunk.mOut += row.mDone ? "\t[X] - " : "\t[ ] - ";
+                chunk.mOut.append(chunk.mText, row.mOffset, row.mLength);
+                chunk.mOut += '\n';
+
+                chunk.mMeta.append(reinterpret_cast<const char*>(&id), sizeof(id));
+                chunk.mMeta.append(reinterpret_cast<const char*>(&row.mCreated), sizeof(row.mCreated));
+                id++;
+            }
+        }
+
+        // A CSV header names its columns; anything else is a file of descriptions.
+        void readHeader(std::string& input)
+        {
+            mColumns = {-1, -1, -1, 0};
+            if(input.starts_with("\xEF\xBB\xBF"))
+                input.erase(0, 3);
+            if(mFormat != Format::csv)
+                return;
+
+            std::size_t length = nextCsvRecord(input);
+            std::string_view record(input.data(), length);
+            while(!record.empty() && (record.back() == '\n' || record.back() == '\r'))
+                record.remove_suffix(1);
+
+            std::array<int, columnCount> columns = {-1, -1, -1, -1};
+            for(int field = 0; !record.empty(); field++)
+            {
+                bool quoted = false;
+                std::string_view name = nextCsvField(record, quoted);
+                if(name == "id")
+                    columns[columnId] = field;
+                else if(name == "done")
+                    columns[columnDone] = field;
+                else if(name == "created")
+                    columns[columnCreated] = field;
+                else if(name == "text")
+                    columns[columnText] = field;
+            }
+
+            if(columns[columnText] < 0)
+                return;
+            mColumns = columns;
+            input.erase(0, length);
+        }
+
+    public:
+        [[maybe_unused]] explicit Importer(const Format& format)
+        : mFormat(format), mNow(0), mColumns{-1, -1, -1, 0}, mChunks()
+        {}
+
+        // Appends every entry of file to the list stored at list. Records that can't be parsed are
+        // counted in skipped.
+        [[maybe_unused]] bool run(const fs::path& list, const fs::path& file, std::size_t& imported, std::size_t& skipped)
+        {
+            std::ifstream inStream(file, std::ios::binary);
+            if(!inStream.is_open())
+            {
+                std::cerr << "Failed to open: " << file << " : " << std::strerror(errno) << std::endl;
+                return false;
+            }
+
+            imported = 0;
+            skipped = 0;
+            mNow = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+            mChunks.resize(std::clamp(std::thread::hardware_concurrency(), 1u, kMaxThreads));
+
+            return List::appendBulk(list, [&](std::uint32_t nextId, std::ofstream& snapshot, std::ofstream& meta)
+            {
+                std::string carry;
+                bool eof = false;
+                bool first = true;
+                while(!eof || !carry.empty())
+                {
+                    std::size_t used = 0;
+                    for(; used < mChunks.size() && (!eof || !carry.empty()); used++)
+                    {
+                        Chunk& chunk = mChunks[used];
+                        chunk.mInput.swap(carry);
+                        carry.clear();
+
+                        // Reads on until at least one record is complete, so a record longer than a
+                        // chunk still ends up in one piece.
+                        while(!eof)
+                        {
+                            std::size_t size = chunk.mInput.size();
+                            chunk.mInput.resize(size + kChunkSize);
+                            inStream.read(chunk.mInput.data() + size, kChunkSize);
+                            chunk.mInput.resize(size + static_cast<std::size_t>(inStream.gcount()));
+                            eof = !inStream;
+
+                            std::size_t end = recordEnd(chunk.mInput);
+                            if(!eof && end != std::string::npos)
+                            {
+                                carry.assign(chunk.mInput, end);
+                                chunk.mInput.resize(end);
+                                break;
+                            }
+                        }
+
+                        if(first)
+                        {
+                            readHeader(chunk.mInput);
+                            first = false;
+                        }
+                    }
+
+                    parallel(used, [this](const std::size_t& i) { parse(mChunks[i]); });
+
+                    std::array<std::uint32_t, kMaxThreads> firstIds{};
+                    for(std::size_t i = 0; i < used; i++)
+                    {
+                        firstIds[i] = nextId;
+                        nextId += static_cast<std::uint32_t>(mChunks[i].mRows.size());
+                    }
+                    parallel(used, [&](const std::size_t& i) { format(mChunks[i], firstIds[i]); });
+
+                    for(std::size_t i = 0; i < used; i++)
+                    {
+                        snapshot.write(mChunks[i].mOut.data(), static_cast<std::streamsize>(mChunks[i].mOut.size()));
+                        meta.write(mChunks[i].mMeta.data(), static_cast<std::streamsize>(mChunks[i].mMeta.size()));
+                        imported += mChunks[i].mRows.size();
+                        skipped += mChunks[i].mSkipped;
+                    }
+                    if(!snapshot || !meta)
+                        return false;
+                }
+                return true;
+            });
+        }
+    };
+
+    // Writes the entries of list to file in list order, buffered in chunks of the same size the
+    // importer reads.
+    [[maybe_unused]] inline bool exportEntries(const List& list, const fs::path& file, const Format& format)
+    {
+        constexpr std::size_t chunkSize = 1 << 20;
+
+        std::ofstream outStream(file, std::ios::binary | std::ios::trunc);
+        if(!outStream.is_open())
+        {
+            std::cerr << "Failed to open: " << file << " : " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        std::string buffer;
+        buffer.reserve(chunkSize + 4096);
+        if(format == Format::csv)
+            buffer += "id,done,created,text\n";
+
+        char digits[24];
+        auto appendNumber = [&](const auto& value)
+        {
+            auto [ptr, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+            buffer.append(digits, ptr);
+        };
+
+        const EntryStore& store = list.store();
+        list.forEach([&](const std::size_t&, const std::uint32_t& slot)
+        {
+            std::string_view text = store.text(slot);
+            if(format == Format::todoTxt)
+            {
+                if(store.done(slot))
+                    buffer += "x ";
+                else
+                {
+                    // todo.txt puts the creation day after the priority.
+                    if(text.size() > 4 && text[0] == '(' && text[2] == ')' && text[3] == ' ')
+                    {
+                        buffer += text.substr(0, 4);
+                        text.remove_prefix(4);
+                    }
+                    std::chrono::sys_seconds created{std::chrono::seconds(store.created(slot))};
+                    std::chrono::year_month_day day{std::chrono::floor<std::chrono::days>(created)};
+                    char date[16];
+                    int len = std::snprintf(date, sizeof(date), "%04d-%02u-%02u ", static_cast<int>(day.year()),
+                                            static_cast<unsigned>(day.month()), static_cast<unsigned>(day.day()));
+                    buffer.append(date, static_cast<std::size_t>(len));
+                }
+                buffer += text;
+            }
+            else if(format == Format::csv)
+            {
+                appendNumber(store.id(slot));
+                buffer += store.done(slot) ? ",1," : ",0,";
+                appendNumber(store.created(slot));
+                buffer += ',';
+                if(text.find_first_of(",\"") == std::string_view::npos)
+                    buffer += text;
+                else
+                {
+                    buffer += '"';
+                    for(char c : text)
+                    {
+                        if(c == '"')
+                            buffer += '"';
+                        buffer += c;
+                    }
+                    buffer += '"';
+                }
+            }
+            else
+            {
+                buffer += "{\"id\":";
+                appendNumber(store.id(slot));
+                buffer += store.done(slot) ? ",\"done\":true,\"created\":" : ",\"done\":false,\"created\":";
+                appendNumber(store.created(slot));
+                buffer += ",\"text\":\"";
+                for(char c : text)
+                {
+                    if(c == '"' || c == '\\')
+                        buffer += '\\';
+                    if(static_cast<unsigned char>(c) < 0x20)
+                    {
+                        char escaped[8];
+                        std::snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned>(c));
+                        buffer += escaped;
+                    }
+                    else
+                        buffer += c;
+                }
+                buffer += "\"}";
+            }
+            buffer += '\n';
+
+            if(buffer.size() >= chunkSize)
+            {
+                outStream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                buffer.clear();
+            }
+        });
+
+        outStream.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        if(!outStream)
+        {
+            std::cerr << "Failed to write: " << file << " : " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+}
+#endif // BULK_IO_HPP
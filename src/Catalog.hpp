@@ -0,0 +1,466 @@
+#ifndef CATALOG_HPP
+#define CATALOG_HPP
+
+#include "../dependencies/FileHandler.hpp"
+#include "FileLock.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Todo
+{
+    // Where a list's entries live: as files in todo_lists/ or packed into the archive segment.
+    enum class Tier : std::uint32_t
+    {
+        hot,
+        cold
+    };
+
+    struct Listing
+    {
+        fs::path mPath;
+        Tier mTier;
+    };
+
+    // The set of known todo lists, shared by every instance working on the same data directory through a
+    // POSIX shared memory segment. Readers don't block on writers: they take a seqlock snapshot. Writers
+    // serialize on a lock over the segment itself, which the kernel drops if a process dies while holding
+    // it; the next writer then evens out the sequence the dead one left odd, and a reader that keeps
+    // seeing it odd takes the writer lock to do the same. The segment is group accessible, so members of
+    // a team sharing todo_lists/ see the same catalog. data/paths.txt remains the persistent copy and
+    // seeds the segment when it is first created; archived lists carry a "\tcold" suffix there.
+    class Catalog
+    {
+    private:
+        static constexpr std::uint32_t kMagic = 0x54444F43; // "TDOC"
+        static constexpr std::uint32_t kCapacity = 1 << 16;
+        static constexpr std::uint32_t kPathCapacity = 248;
+        static constexpr std::uint32_t kSpinLimit = 1 << 16;
+        static constexpr int kSegmentMode = 0660;
+
+        struct Slot
+        {
+            std::uint32_t mLength;
+            Tier mTier;
+            char mPath[kPathCapacity];
+        };
+
+        struct Header
+        {
+            std::atomic<std::uint32_t> mMagic;
+            std::atomic<std::uint32_t> mCount;
+            std::atomic<std::uint64_t> mSequence;
+        };
+
+        static constexpr std::size_t kSegmentSize = sizeof(Header) + sizeof(Slot) * kCapacity;
+
+        fs::path mListDirPath;
+        int mFd;
+        Header* mHeader;
+        Slot* mSlots;
+        std::vector<Listing> mLocal; // used when shared memory isn't available
+
+        static std::string segmentName(const fs::path& listDirPath)
+        {
+            std::error_code ec;
+            std::string key = fs::absolute(listDirPath, ec).lexically_normal().string();
+            std::uint64_t hash = 14695981039346656037ull;
+            for(unsigned char c : key)
+            {
+                hash ^= c;
+                hash *= 1099511628211ull;
+            }
+
+            char name[32];
+            std::snprintf(name, sizeof(name), "/TodoApp-%016llx", static_cast<unsigned long long>(hash));
+            return name;
+        }
+
+        static std::vector<Listing> readPathsFile(const fs::path& listDirPath)
+        {
+            std::vector<std::string> lines;
+            std::vector<Listing> listings;
+            if(fs::exists(listDirPath) && FileHandler::GetLinesFromFile(listDirPath, lines))
+                for(auto& line : lines)
+                {
+                    if(line.empty())
+                        continue;
+                    Tier tier = line.ends_with("\tcold") ? Tier::cold : Tier::hot;
+                    if(tier == Tier::cold)
+                        line.erase(line.size() - 5);
+                    listings.push_back(Listing{line, tier});
+                }
+            return listings;
+        }
+
+        bool shared() const
+        {
+            return mHeader != nullptr;
+        }
+
+        // Makes the sequence odd for a change. Holding the writer lock, an odd sequence can only have
+        // been left by a writer that died halfway, so it is moved on to the next odd value.
+        void beginWriteLocked()
+        {
+            std::uint64_t sequence = mHeader->mSequence.load(std::memory_order_relaxed);
+            mHeader->mSequence.store(sequence + 1 + (sequence & 1), std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+        }
+
+        void endWriteLocked()
+        {
+            mHeader->mSequence.fetch_add(1, std::memory_order_release);
+        }
+
+        // For readers that found a change in progress for too long: waits for the writer, and if it
+        // turns out to have died, evens the sequence out.
+        void repairSequence() const
+        {
+            FileLock writer(mFd, LockMode::exclusive);
+            if(writer.failed())
+                return;
+            std::uint64_t sequence = mHeader->mSequence.load(std::memory_order_relaxed);
+            if(sequence & 1)
+                mHeader->mSequence.store(sequence + 1, std::memory_order_release);
+        }
+
+        Slot* findLocked(const std::string& path) const
+        {
+            std::uint32_t count = mHeader->mCount.load(std::memory_order_relaxed);
+            for(std::uint32_t i = 0; i < count; i++)
+                if(std::string_view(mSlots[i].mPath, mSlots[i].mLength) == path)
+                    return &mSlots[i];
+            return nullptr;
+        }
+
+        // Caller holds the writer lock. Callers adding many paths check for duplicates themselves.
+        bool appendLocked(const std::string& path, const Tier& tier = Tier::hot, const bool& checked = false)
+        {
+            if(path.size() > kPathCapacity)
+            {
+                std::cerr << "Failed to add list to catalog: path too long: " << path << std::endl;
+                return false;
+            }
+            if(!checked && findLocked(path))
+                return true;
+
+            std::uint32_t count = mHeader->mCount.load(std::memory_order_relaxed);
+            if(count >= kCapacity)
+            {
+                std::cerr << "Failed to add list to catalog: catalog is full" << std::endl;
+                return false;
+            }
+
+            beginWriteLocked();
+            Slot& slot = mSlots[count];
+            slot.mLength = static_cast<std::uint32_t>(path.size());
+            slot.mTier = tier;
+            std::memcpy(slot.mPath, path.data(), path.size());
+            mHeader->mCount.store(count + 1, std::memory_order_relaxed);
+            endWriteLocked();
+            return true;
+        }
+
+        void mergeLocked(const std::vector<Listing>& listings)
+        {
+            std::unordered_set<std::string> known;
+            std::uint32_t count = mHeader->mCount.load(std::memory_order_relaxed);
+            for(std::uint32_t i = 0; i < count; i++)
+                known.emplace(mSlots[i].mPath, mSlots[i].mLength);
+            for(auto& listing : listings)
+            {
+                std::string path = listing.mPath.string();
+                if(known.insert(path).second)
+                    appendLocked(path, listing.mTier, true);
+            }
+        }
+
+        bool attach()
+        {
+#ifndef _WIN32
+            std::string name = segmentName(mListDirPath);
+            mFd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, kSegmentMode);
+            if(mFd < 0)
+            {
+                std::cerr << "Failed to open the shared catalog: " << std::strerror(errno)
+                          << ", lists created by other instances won't show up until restart" << std::endl;
+                return false;
+            }
+
+            FileLock writer(mFd, LockMode::exclusive);
+
+            struct stat st{};
+            if(writer.failed() || fstat(mFd, &st) < 0 || (static_cast<std::size_t>(st.st_size) < kSegmentSize
+                                       && ftruncate(mFd, static_cast<off_t>(kSegmentSize)) < 0))
+            {
+                close(mFd);
+                mFd = -1;
+                return false;
+            }
+
+            void* memory = mmap(nullptr, kSegmentSize, PROT_READ | PROT_WRITE, MAP_SHARED, mFd, 0);
+            if(memory == MAP_FAILED)
+            {
+                close(mFd);
+                mFd = -1;
+                return false;
+            }
+
+            mHeader = static_cast<Header*>(memory);
+            mSlots = reinterpret_cast<Slot*>(static_cast<char*>(memory) + sizeof(Header));
+
+            // Whoever gets the lock first on a fresh segment seeds it. A process that died halfway leaves
+            // the magic unset, so the next one simply starts over.
+            if(mHeader->mMagic.load(std::memory_order_acquire) != kMagic)
+            {
+                mHeader->mCount.store(0, std::memory_order_relaxed);
+                mHeader->mSequence.store(0, std::memory_order_relaxed);
+                mergeLocked(readPathsFile(mListDirPath));
+                mHeader->mMagic.store(kMagic, std::memory_order_release);
+            }
+            return true;
+#else
+            return false;
+#endif
+        }
+
+    public:
+        [[maybe_unused]] explicit Catalog(const fs::path& listDirPath)
+        : mListDirPath(listDirPath), mFd(-1), mHeader(nullptr), mSlots(nullptr), mLocal()
+        {
+            FileHandler::CreateFile(mListDirPath);
+            if(!attach())
+                mLocal = readPathsFile(mListDirPath);
+        }
+
+        Catalog(const Catalog&) = delete;
+        Catalog& operator=(const Catalog&) = delete;
+
+        ~Catalog()
+        {
+#ifndef _WIN32
+            if(mHeader)
+                munmap(mHeader, kSegmentSize);
+            if(mFd >= 0)
+                close(mFd);
+#endif
+        }
+
+        [[maybe_unused]] bool add(const fs::path& path)
+        {
+            if(!shared())
+            {
+                if(std::find_if(mLocal.begin(), mLocal.end(), [&](const Listing& l) { return l.mPath == path; }) == mLocal.end())
+                    mLocal.push_back(Listing{path, Tier::hot});
+                return true;
+            }
+
+            FileLock writer(mFd, LockMode::exclusive);
+            return !writer.failed() && appendLocked(path.string());
+        }
+
+        // Lists already in the catalog keep their tier.
+        [[maybe_unused]] void merge(const std::vector<Listing>& listings)
+        {
+            if(!shared())
+            {
+                for(auto& listing : listings)
+                    if(std::find_if(mLocal.begin(), mLocal.end(), [&](const Listing& l) { return l.mPath == listing.mPath; })
+                       == mLocal.end())
+                        mLocal.push_back(listing);
+                return;
+            }
+
+            FileLock writer(mFd, LockMode::exclusive);
+            if(!writer.failed())
+                mergeLocked(listings);
+        }
+
+        [[maybe_unused]] void mergeFromFile()
+        {
+            merge(readPathsFile(mListDirPath));
+        }
+
+        [[maybe_unused]] bool setTier(const fs::path& path, const Tier& tier)
+        {
+            if(!shared())
+            {
+                auto it = std::find_if(mLocal.begin(), mLocal.end(), [&](const Listing& l) { return l.mPath == path; });
+                if(it == mLocal.end())
+                    return false;
+                it->mTier = tier;
+                return true;
+            }
+
+            FileLock writer(mFd, LockMode::exclusive);
+            Slot* slot = writer.failed() ? nullptr : findLocked(path.string());
+            if(!slot)
+                return false;
+            beginWriteLocked();
+            slot->mTier = tier;
+            endWriteLocked();
+            return true;
+        }
+
+        // Moves all paths to tier in one update. Returns false if some path isn't in the catalog.
+        [[maybe_unused]] bool setTier(const std::vector<fs::path>& paths, const Tier& tier)
+        {
+            std::unordered_map<std::string, Tier*> tiers;
+            auto apply = [&]()
+            {
+                bool found = true;
+                for(auto& path : paths)
+                {
+                    auto it = tiers.find(path.string());
+                    if(it == tiers.end())
+                        found = false;
+                    else
+                        *it->second = tier;
+                }
+                return found;
+            };
+
+            if(!shared())
+            {
+                for(Listing& listing : mLocal)
+                    tiers.emplace(listing.mPath.string(), &listing.mTier);
+                return apply();
+            }
+
+            FileLock writer(mFd, LockMode::exclusive);
+            if(writer.failed())
+                return false;
+            std::uint32_t count = mHeader->mCount.load(std::memory_order_relaxed);
+            for(std::uint32_t i = 0; i < count; i++)
+                tiers.emplace(std::string(mSlots[i].mPath, mSlots[i].mLength), &mSlots[i].mTier);
+            beginWriteLocked();
+            bool found = apply();
+            endWriteLocked();
+            return found;
+        }
+
+        [[maybe_unused]] std::vector<Listing> listings() const
+        {
+            if(!shared())
+                return mLocal;
+
+            std::vector<Listing> result;
+            std::string buffer;
+            std::vector<Tier> tiers;
+            for(std::uint32_t spins = 0;; spins++)
+            {
+                std::uint64_t before = mHeader->mSequence.load(std::memory_order_acquire);
+                if(before & 1)
+                {
+                    if(spins >= kSpinLimit)
+                    {
+                        repairSequence();
+                        spins = 0;
+                    }
+                    continue;
+                }
+
+                buffer.clear();
+                tiers.clear();
+                std::uint32_t count = std::min(mHeader->mCount.load(std::memory_order_relaxed), kCapacity);
+                for(std::uint32_t i = 0; i < count; i++)
+                {
+                    std::uint32_t length = std::min(mSlots[i].mLength, kPathCapacity);
+                    buffer.append(mSlots[i].mPath, length);
+                    buffer += '\n';
+                    tiers.push_back(mSlots[i].mTier);
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(mHeader->mSequence.load(std::memory_order_relaxed) == before)
+                    break;
+            }
+
+            std::size_t begin = 0;
+            std::size_t end;
+            while((end = buffer.find('\n', begin)) != std::string::npos)
+            {
+                result.push_back(Listing{buffer.substr(begin, end - begin), tiers[result.size()]});
+                begin = end + 1;
+            }
+            return result;
+        }
+
+        // Lists the catalog doesn't know are hot.
+        [[maybe_unused]] Tier tier(const fs::path& path) const
+        {
+            if(!shared())
+            {
+                auto it = std::find_if(mLocal.begin(), mLocal.end(), [&](const Listing& l) { return l.mPath == path; });
+                return it == mLocal.end() ? Tier::hot : it->mTier;
+            }
+
+            std::string key = path.string();
+            for(std::uint32_t spins = 0;; spins++)
+            {
+                std::uint64_t before = mHeader->mSequence.load(std::memory_order_acquire);
+                if(before & 1)
+                {
+                    if(spins >= kSpinLimit)
+                    {
+                        repairSequence();
+                        spins = 0;
+                    }
+                    continue;
+                }
+
+                Tier tier = Tier::hot;
+                std::uint32_t count = std::min(mHeader->mCount.load(std::memory_order_relaxed), kCapacity);
+                for(std::uint32_t i = 0; i < count; i++)
+                {
+                    if(std::string_view(mSlots[i].mPath, std::min(mSlots[i].mLength, kPathCapacity)) == key)
+                    {
+                        tier = mSlots[i].mTier;
+                        break;
+                    }
+                }
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if(mHeader->mSequence.load(std::memory_order_relaxed) == before)
+                    return tier;
+            }
+        }
+
+        // Writes the catalog back to data/paths.txt, keeping lines some other writer added in the meantime.
+        [[maybe_unused]] bool save() const
+        {
+            FileLock lock(mListDirPath, LockMode::exclusive);
+            if(lock.failed())
+                return false;
+
+            std::vector<Listing> all = readPathsFile(mListDirPath);
+            std::unordered_map<std::string, std::size_t> index;
+            for(std::size_t i = 0; i < all.size(); i++)
+                index.emplace(all[i].mPath.string(), i);
+            for(auto& listing : listings())
+            {
+                auto [it, inserted] = index.emplace(listing.mPath.string(), all.size());
+                if(inserted)
+                    all.push_back(listing);
+                else
+                    all[it->second].mTier = listing.mTier;
+            }
+
+            std::string outString;
+            for(auto& listing : all)
+                outString += listing.mPath.string() + (listing.mTier == Tier::cold ? "\tcold\n" : "\n");
+            return FileHandler::WriteToFile(mListDirPath, outString);
+        }
+    };
+}
+#endif // CATALOG_HPP
@@ -0,0 +1,190 @@
+#ifndef ENTRY_STORE_HPP
+#define ENTRY_STORE_HPP
+
+#include <bit>
+#include <charconv>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Todo
+{
+    // Column oriented storage for the entries of one list. Completion state is a packed bitset, the
+    // descriptions live back to back in one text blob addressed through offset/length columns, and
+    // ids and creation times are parallel arrays. The text format of a list file is only produced on
+    // demand by format().
+    //
+    // Entries are addressed by slot, which never changes while the list is open. Deleted slots are
+    // cleared from the live bitset and reused only when the list is loaded again; the order of the
+    // live slots is kept by an OrderTree.
+    class EntryStore
+    {
+    private:
+        std::pmr::vector<std::uint64_t> mDone;
+        std::pmr::vector<std::uint64_t> mLive;
+        std::size_t mLiveCount;
+        std::pmr::vector<char> mText;
+        std::pmr::vector<std::uint64_t> mOffsets;
+        std::pmr::vector<std::uint32_t> mLengths;
+        std::pmr::vector<std::uint32_t> mIds;
+        std::pmr::vector<std::int64_t> mCreated;
+
+        std::uint64_t appendText(std::string_view text)
+        {
+            std::uint64_t offset = mText.size();
+            mText.insert(mText.end(), text.begin(), text.end());
+            return offset;
+        }
+
+    public:
+        [[maybe_unused]] explicit EntryStore(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : mDone(resource), mLive(resource), mLiveCount(0), mText(resource), mOffsets(resource), mLengths(resource),
+          mIds(resource), mCreated(resource)
+        {}
+
+        [[maybe_unused]] std::size_t size() const
+        {
+            return mIds.size();
+        }
+
+        [[maybe_unused]] bool empty() const
+        {
+            return mIds.empty();
+        }
+
+        [[maybe_unused]] std::size_t liveCount() const
+        {
+            return mLiveCount;
+        }
+
+        [[maybe_unused]] void push(const std::uint32_t& id, const bool& done, std::string_view text, const std::int64_t& created)
+        {
+            std::size_t index = size();
+            if(index % 64 == 0)
+            {
+                mDone.emplace_back(0);
+                mLive.emplace_back(0);
+            }
+            mLive[index / 64] |= std::uint64_t(1) << (index % 64);
+            mLiveCount++;
+            mOffsets.emplace_back(appendText(text));
+            mLengths.emplace_back(static_cast<std::uint32_t>(text.size()));
+            mIds.emplace_back(id);
+            mCreated.emplace_back(created);
+            setDone(index, done);
+        }
+
+        [[maybe_unused]] void setId(const std::size_t& index, const std::uint32_t& id)
+        {
+            mIds[index] = id;
+        }
+
+        [[maybe_unused]] void setDone(const std::size_t& index, const bool& done)
+        {
+            std::uint64_t bit = std::uint64_t(1) << (index % 64);
+            if(done)
+                mDone[index / 64] |= bit;
+            else
+                mDone[index / 64] &= ~bit;
+        }
+
+        [[maybe_unused]] void erase(const std::size_t& index)
+        {
+            if(!live(index))
+                return;
+            setDone(index, false);
+            mLive[index / 64] &= ~(std::uint64_t(1) << (index % 64));
+            mLiveCount--;
+        }
+
+        [[maybe_unused]] bool live(const std::size_t& index) const
+        {
+            return (mLive[index / 64] >> (index % 64)) & 1;
+        }
+
+        [[maybe_unused]] bool done(const std::size_t& index) const
+        {
+            return (mDone[index / 64] >> (index % 64)) & 1;
+        }
+
+        [[maybe_unused]] std::string_view text(const std::size_t& index) const
+        {
+            return {mText.data() + mOffsets[index], mLengths[index]};
+        }
+
+        [[maybe_unused]] std::uint32_t id(const std::size_t& index) const
+        {
+            return mIds[index];
+        }
+
+        [[maybe_unused]] std::int64_t created(const std::size_t& index) const
+        {
+            return mCreated[index];
+        }
+
+        [[maybe_unused]] const std::pmr::vector<std::uint64_t>& doneBits() const
+        {
+            return mDone;
+        }
+
+        [[maybe_unused]] const std::pmr::vector<std::uint64_t>& liveBits() const
+        {
+            return mLive;
+        }
+
+        // Bits past the last entry and of deleted entries are always zero, so whole words can be counted.
+        [[maybe_unused]] std::size_t doneCount() const
+        {
+            std::size_t count = 0;
+            for(std::uint64_t word : mDone)
+                count += static_cast<std::size_t>(std::popcount(word));
+            return count;
+        }
+
+        // Appends the entry in the list file format: "<id>\t[ ] - <text>" or "<id>\t[X] - <text>".
+        template<typename String>
+        void format(const std::size_t& index, String& out) const
+        {
+            format(index, out, mIds[index]);
+        }
+
+        // Same layout with another number in front, e.g. the position on screen.
+        template<typename String>
+        void format(const std::size_t& index, String& out, const std::uint64_t& number) const
+        {
+            char digits[24];
+            auto [ptr, ec] = std::to_chars(digits, digits + sizeof(digits), number);
+            out.append(digits, ptr);
+            out += done(index) ? "\t[X] - " : "\t[ ] - ";
+            out += text(index);
+        }
+
+        struct ParsedLine
+        {
+            std::uint32_t mId;
+            bool mDone;
+            std::string_view mText;
+        };
+
+        // Lines that don't follow the list format keep their whole content as text and take fallbackId.
+        [[maybe_unused]] static ParsedLine parse(std::string_view line, const std::uint32_t& fallbackId)
+        {
+            ParsedLine parsed{fallbackId, false, line};
+
+            std::uint32_t id = 0;
+            auto [ptr, ec] = std::from_chars(line.data(), line.data() + line.size(), id);
+            std::string_view rest(ptr, static_cast<std::size_t>(line.data() + line.size() - ptr));
+            if(ec != std::errc() || rest.size() < 7 || rest[0] != '\t' || rest[1] != '[' || rest[3] != ']'
+               || rest.substr(4, 3) != " - ")
+                return parsed;
+
+            parsed.mId = id;
+            parsed.mDone = rest[2] != ' ';
+            parsed.mText = rest.substr(7);
+            return parsed;
+        }
+    };
+}
+#endif // ENTRY_STORE_HPP
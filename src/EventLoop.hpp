@@ -0,0 +1,439 @@
+#ifndef EVENT_LOOP_HPP
+#define EVENT_LOOP_HPP
+
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+namespace Todo
+{
+    // Lazily started coroutine. Awaiting a Task runs it and resumes the awaiter when it finishes;
+    // Reactor::spawn runs one detached instead.
+    template<typename T = void>
+    class Task;
+
+    namespace Detail
+    {
+        struct PromiseBase
+        {
+            std::coroutine_handle<> mContinuation;
+            std::exception_ptr mException;
+            void* mOwner = nullptr;
+            void (*mOnFinish)(void*, std::coroutine_handle<>, std::exception_ptr) = nullptr;
+
+            struct FinalAwaiter
+            {
+                bool await_ready() noexcept { return false; }
+
+                template<typename Promise>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+                {
+                    PromiseBase& promise = handle.promise();
+                    if(promise.mContinuation)
+                        return promise.mContinuation;
+
+                    // Detached: the frame cleans up after itself and a failure goes to the owner, if any.
+                    if(promise.mOnFinish)
+                        promise.mOnFinish(promise.mOwner, handle, promise.mException);
+                    else if(promise.mException)
+                    {
+                        try { std::rethrow_exception(promise.mException); }
+                        catch(const std::exception& e) { std::cerr << "Unhandled exception in task: " << e.what() << std::endl; }
+                        catch(...) { std::cerr << "Unhandled exception in task" << std::endl; }
+                    }
+                    handle.destroy();
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            FinalAwaiter final_suspend() noexcept { return {}; }
+            void unhandled_exception() { mException = std::current_exception(); }
+        };
+
+        template<typename T>
+        struct Promise : PromiseBase
+        {
+            std::optional<T> mValue;
+
+            Task<T> get_return_object();
+            void return_value(T value) { mValue.emplace(std::move(value)); }
+        };
+
+        template<>
+        struct Promise<void> : PromiseBase
+        {
+            Task<void> get_return_object();
+            void return_void() {}
+        };
+    }
+
+    template<typename T>
+    class Task
+    {
+    public:
+        using promise_type = Detail::Promise<T>;
+
+    private:
+        std::coroutine_handle<promise_type> mHandle;
+
+    public:
+        explicit Task(std::coroutine_handle<promise_type> handle)
+        : mHandle(handle)
+        {}
+
+        Task(Task&& other) noexcept
+        : mHandle(std::exchange(other.mHandle, {}))
+        {}
+
+        Task(const Task&) = delete;
+        Task& operator=(const Task&) = delete;
+
+        ~Task()
+        {
+            if(mHandle)
+                mHandle.destroy();
+        }
+
+        bool await_ready() const noexcept
+        {
+            return false;
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+        {
+            mHandle.promise().mContinuation = awaiter;
+            return mHandle;
+        }
+
+        T await_resume()
+        {
+            if(mHandle.promise().mException)
+                std::rethrow_exception(mHandle.promise().mException);
+            if constexpr(!std::is_void_v<T>)
+                return std::move(*mHandle.promise().mValue);
+        }
+
+        std::coroutine_handle<promise_type> release()
+        {
+            return std::exchange(mHandle, {});
+        }
+    };
+
+    namespace Detail
+    {
+        template<typename T>
+        Task<T> Promise<T>::get_return_object()
+        {
+            return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+        }
+
+        inline Task<void> Promise<void>::get_return_object()
+        {
+            return Task<void>(std::coroutine_handle<Promise<void>>::from_promise(*this));
+        }
+    }
+
+    // Single threaded scheduler: epoll for file descriptors, a heap of deadlines for timers and a queue
+    // of coroutines that are ready to continue. Without epoll, readable() completes immediately and
+    // the caller does a blocking read instead.
+    class Reactor
+    {
+    private:
+        using Clock = std::chrono::steady_clock;
+
+        struct Timer
+        {
+            Clock::time_point mDeadline;
+            std::uint64_t mSequence;
+            std::coroutine_handle<> mHandle;
+
+            bool operator>(const Timer& other) const
+            {
+                return mDeadline != other.mDeadline ? mDeadline > other.mDeadline : mSequence > other.mSequence;
+            }
+        };
+
+        int mEpollFd;
+        bool mStopped;
+        std::uint64_t mTimerSequence;
+        std::deque<std::coroutine_handle<>> mReady;
+        std::priority_queue<Timer, std::vector<Timer>, std::greater<>> mTimers;
+        std::unordered_map<int, std::coroutine_handle<>> mWaiters;
+        std::unordered_set<void*> mRoots;
+        std::exception_ptr mFailure;
+
+        // A root task that failed leaves the others waiting for something that won't happen anymore,
+        // e.g. watchers keeping the loop alive without anyone reading input, so the loop stops.
+        static void onRootFinished(void* owner, std::coroutine_handle<> handle, std::exception_ptr exception)
+        {
+            auto reactor = static_cast<Reactor*>(owner);
+            reactor->mRoots.erase(handle.address());
+            if(exception && !reactor->mFailure)
+            {
+                reactor->mFailure = exception;
+                reactor->mStopped = true;
+            }
+        }
+
+        struct ReadableAwaiter
+        {
+            Reactor& mReactor;
+            int mFd;
+
+            bool await_ready() const noexcept
+            {
+                return mReactor.mEpollFd < 0;
+            }
+
+            bool await_suspend(std::coroutine_handle<> handle)
+            {
+#ifdef __linux__
+                epoll_event ev{};
+                ev.events = EPOLLIN;
+                ev.data.fd = mFd;
+                if(epoll_ctl(mReactor.mEpollFd, EPOLL_CTL_ADD, mFd, &ev) < 0)
+                    return false;
+                mReactor.mWaiters[mFd] = handle;
+                return true;
+#else
+                (void)handle;
+                return false;
+#endif
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        struct SleepAwaiter
+        {
+            Reactor& mReactor;
+            Clock::time_point mDeadline;
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                mReactor.mTimers.push(Timer{mDeadline, mReactor.mTimerSequence++, handle});
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        struct YieldAwaiter
+        {
+            Reactor& mReactor;
+
+            bool await_ready() const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                mReactor.mReady.push_back(handle);
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        void fireTimers()
+        {
+            auto now = Clock::now();
+            while(!mTimers.empty() && mTimers.top().mDeadline <= now)
+            {
+                mReady.push_back(mTimers.top().mHandle);
+                mTimers.pop();
+            }
+        }
+
+        void wait()
+        {
+            int timeout = -1;
+            if(!mReady.empty())
+                timeout = 0;
+            else if(!mTimers.empty())
+            {
+                auto delta = std::chrono::ceil<std::chrono::milliseconds>(mTimers.top().mDeadline - Clock::now());
+                timeout = static_cast<int>(std::max<std::chrono::milliseconds::rep>(delta.count(), 0));
+            }
+
+#ifdef __linux__
+            if(mEpollFd >= 0 && (!mWaiters.empty() || timeout != 0))
+            {
+                epoll_event events[64];
+                int count = epoll_wait(mEpollFd, events, 64, timeout);
+                for(int i = 0; i < count; i++)
+                {
+                    int fd = events[i].data.fd;
+                    auto it = mWaiters.find(fd);
+                    if(it == mWaiters.end())
+                        continue;
+                    epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+                    mReady.push_back(it->second);
+                    mWaiters.erase(it);
+                }
+                return;
+            }
+#endif
+            if(timeout > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(timeout));
+        }
+
+    public:
+        [[maybe_unused]] Reactor()
+        : mEpollFd(-1), mStopped(false), mTimerSequence(0), mReady(), mTimers(), mWaiters(), mRoots(), mFailure()
+        {
+#ifdef __linux__
+            mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+        }
+
+        Reactor(const Reactor&) = delete;
+        Reactor& operator=(const Reactor&) = delete;
+
+        ~Reactor()
+        {
+            // Tasks still parked on a descriptor or timer are torn down together with what they await.
+            for(void* root : mRoots)
+                std::coroutine_handle<>::from_address(root).destroy();
+#ifdef __linux__
+            if(mEpollFd >= 0)
+                close(mEpollFd);
+#endif
+        }
+
+        [[maybe_unused]] ReadableAwaiter readable(const int& fd)
+        {
+            return ReadableAwaiter{*this, fd};
+        }
+
+        template<typename Rep, typename Period>
+        [[maybe_unused]] SleepAwaiter sleepFor(const std::chrono::duration<Rep, Period>& duration)
+        {
+            return SleepAwaiter{*this, Clock::now() + std::chrono::duration_cast<Clock::duration>(duration)};
+        }
+
+        [[maybe_unused]] YieldAwaiter yield()
+        {
+            return YieldAwaiter{*this};
+        }
+
+        [[maybe_unused]] void spawn(Task<void>&& task)
+        {
+            auto handle = task.release();
+            handle.promise().mOwner = this;
+            handle.promise().mOnFinish = &Reactor::onRootFinished;
+            mRoots.insert(handle.address());
+            mReady.push_back(handle);
+        }
+
+        [[maybe_unused]] void stop()
+        {
+            mStopped = true;
+        }
+
+        // Runs until stop() is called, nothing is left to wait for or a spawned task fails; the exception
+        // of a failed task is rethrown.
+        [[maybe_unused]] void run()
+        {
+            mStopped = false;
+            while(!mStopped && !mRoots.empty())
+            {
+                while(!mReady.empty() && !mStopped)
+                {
+                    auto handle = mReady.front();
+                    mReady.pop_front();
+                    handle.resume();
+                }
+                if(mStopped)
+                    break;
+                wait();
+                fireTimers();
+            }
+            if(mFailure)
+                std::rethrow_exception(std::exchange(mFailure, {}));
+        }
+    };
+
+    // Line oriented reader on top of the reactor. Lines are split from our own buffer, so a line that
+    // arrived together with the previous one never sits unnoticed in a stdio buffer.
+    class LineReader
+    {
+    private:
+        Reactor& mReactor;
+        int mFd;
+        std::string mPending;
+        bool mEof;
+
+    public:
+        [[maybe_unused]] LineReader(Reactor& reactor, const int& fd)
+        : mReactor(reactor), mFd(fd), mPending(), mEof(false)
+        {}
+
+        // Returns nothing once the input is exhausted.
+        [[maybe_unused]] Task<std::optional<std::string>> readLine()
+        {
+#ifdef __linux__
+            while(true)
+            {
+                std::size_t newline = mPending.find('\n');
+                if(newline != std::string::npos)
+                {
+                    std::string line = mPending.substr(0, newline);
+                    mPending.erase(0, newline + 1);
+                    if(line.ends_with('\r'))
+                        line.pop_back();
+                    co_return line;
+                }
+
+                if(mEof)
+                {
+                    if(mPending.empty())
+                        co_return std::nullopt;
+                    co_return std::exchange(mPending, {});
+                }
+
+                co_await mReactor.readable(mFd);
+
+                char buffer[4096];
+                ssize_t len = read(mFd, buffer, sizeof(buffer));
+                if(len < 0 && (errno == EINTR || errno == EAGAIN))
+                    continue;
+                if(len <= 0)
+                    mEof = true;
+                else
+                    mPending.append(buffer, static_cast<std::size_t>(len));
+            }
+#else
+            (void)mFd;
+            co_await mReactor.yield();
+            std::string line;
+            if(!std::getline(std::cin, line))
+                co_return std::nullopt;
+            co_return line;
+#endif
+        }
+    };
+}
+#endif // EVENT_LOOP_HPP
@@ -0,0 +1,156 @@
+#ifndef FILE_LOCK_HPP
+#define FILE_LOCK_HPP
+
+#include "../dependencies/FileHandler.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace Todo
+{
+    enum class LockMode
+    {
+        shared,
+        exclusive
+    };
+
+    // Advisory byte-range lock on a file, released when the object goes out of scope. Open file
+    // description locks are used where available, so closing another stream on the same file (as
+    // FileHandler does after every write) doesn't drop the lock. Elsewhere it degrades to a whole-file
+    // flock(), and on Windows to no locking at all. Writers check failed() and give up rather than
+    // change files unprotected.
+    //
+    // Several users may share the data directories, so lock files are created group writable (the
+    // umask still applies), and a shared lock only needs read access to the file.
+    class FileLock
+    {
+    private:
+        static constexpr int kFileMode = 0664;
+
+        int mFd;
+        bool mOwnsFd;
+        bool mLocked;
+        bool mFailed;
+
+    public:
+        [[maybe_unused]] FileLock()
+        : mFd(-1), mOwnsFd(false), mLocked(false), mFailed(false)
+        {}
+
+        [[maybe_unused]] FileLock(const fs::path& path, const LockMode& mode,
+                                  const std::uintmax_t& start = 0, const std::uintmax_t& length = 0)
+        : mFd(-1), mOwnsFd(true), mLocked(false), mFailed(false)
+        {
+#ifndef _WIN32
+            mFd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, kFileMode);
+            if(mFd < 0 && errno == EACCES && mode == LockMode::shared)
+                mFd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if(mFd < 0)
+            {
+                std::cerr << "Failed to open: " << path << " for locking : " << std::strerror(errno) << std::endl;
+                mFailed = true;
+                return;
+            }
+            lock(mode, start, length);
+#endif
+        }
+
+        [[maybe_unused]] FileLock(const int& fd, const LockMode& mode,
+                                  const std::uintmax_t& start = 0, const std::uintmax_t& length = 0)
+        : mFd(fd), mOwnsFd(false), mLocked(false), mFailed(false)
+        {
+            lock(mode, start, length);
+        }
+
+        FileLock(const FileLock&) = delete;
+        FileLock& operator=(const FileLock&) = delete;
+
+        ~FileLock()
+        {
+            unlock();
+#ifndef _WIN32
+            if(mOwnsFd && mFd >= 0)
+                close(mFd);
+#endif
+        }
+
+        [[maybe_unused]] bool lock(const LockMode& mode, const std::uintmax_t& start = 0, const std::uintmax_t& length = 0)
+        {
+#ifndef _WIN32
+            if(mFd < 0)
+            {
+                mFailed = true;
+                return false;
+            }
+#ifdef F_OFD_SETLKW
+            struct flock fl{};
+            fl.l_type = mode == LockMode::exclusive ? F_WRLCK : F_RDLCK;
+            fl.l_whence = SEEK_SET;
+            fl.l_start = static_cast<off_t>(start);
+            fl.l_len = static_cast<off_t>(length);
+            while(fcntl(mFd, F_OFD_SETLKW, &fl) < 0)
+            {
+                if(errno != EINTR)
+                {
+                    std::cerr << "Failed to lock file : " << std::strerror(errno) << std::endl;
+                    mFailed = true;
+                    return false;
+                }
+            }
+#else
+            (void)start;
+            (void)length;
+            while(flock(mFd, mode == LockMode::exclusive ? LOCK_EX : LOCK_SH) < 0)
+            {
+                if(errno != EINTR)
+                {
+                    std::cerr << "Failed to lock file : " << std::strerror(errno) << std::endl;
+                    mFailed = true;
+                    return false;
+                }
+            }
+#endif
+            mLocked = true;
+            mFailed = false;
+            return true;
+#else
+            (void)mode;
+            (void)start;
+            (void)length;
+            return false;
+#endif
+        }
+
+        [[maybe_unused]] void unlock()
+        {
+#ifndef _WIN32
+            if(!mLocked)
+                return;
+#ifdef F_OFD_SETLKW
+            struct flock fl{};
+            fl.l_type = F_UNLCK;
+            fl.l_whence = SEEK_SET;
+            fcntl(mFd, F_OFD_SETLK, &fl);
+#else
+            flock(mFd, LOCK_UN);
+#endif
+            mLocked = false;
+#endif
+        }
+
+        [[maybe_unused]] bool locked() const
+        {
+            return mLocked;
+        }
+
+        // Whether the lock was wanted but couldn't be taken. Never true where locking isn't supported.
+        [[maybe_unused]] bool failed() const
+        {
+            return mFailed;
+        }
+    };
+}
+#endif // FILE_LOCK_HPP
@@ -0,0 +1,155 @@
+#ifndef LIST_WATCHER_HPP
+#define LIST_WATCHER_HPP
+
+#include "../dependencies/FileHandler.hpp"
+#include <algorithm>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Todo
+{
+    // Reports files that were written by someone else. Directories are watched instead of the files
+    // themselves so that editors which replace a file through a rename are still noticed.
+    class Watcher
+    {
+    private:
+        struct Directory
+        {
+            int mWd;
+            fs::path mPath;
+        };
+
+        int mFd;
+        std::vector<Directory> mDirs;
+        std::vector<fs::path> mFiles;
+
+        static fs::path normalize(const fs::path& path)
+        {
+            std::error_code ec;
+            fs::path absolute = fs::absolute(path, ec);
+            if(ec)
+                return path.lexically_normal();
+            return absolute.lexically_normal();
+        }
+
+    public:
+        [[maybe_unused]] Watcher()
+        : mFd(-1), mDirs(), mFiles()
+        {
+#ifdef __linux__
+            mFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+            if(mFd < 0)
+                std::cerr << "Failed to start file watcher : " << std::strerror(errno) << std::endl;
+#endif
+        }
+
+        Watcher(const Watcher&) = delete;
+        Watcher& operator=(const Watcher&) = delete;
+
+        ~Watcher()
+        {
+#ifdef __linux__
+            if(mFd >= 0)
+                close(mFd);
+#endif
+        }
+
+        [[maybe_unused]] int fd() const
+        {
+            return mFd;
+        }
+
+        [[maybe_unused]] bool watch(const fs::path& file)
+        {
+            if(mFd < 0)
+                return false;
+
+            fs::path path = normalize(file);
+            if(std::find(mFiles.begin(), mFiles.end(), path) != mFiles.end())
+                return true;
+
+#ifdef __linux__
+            fs::path dir = path.parent_path();
+            auto it = std::find_if(mDirs.begin(), mDirs.end(), [&](const Directory& d) { return d.mPath == dir; });
+            if(it == mDirs.end())
+            {
+                int wd = inotify_add_watch(mFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+                if(wd < 0)
+                {
+                    std::cerr << "Failed to watch: " << dir << " : " << std::strerror(errno) << std::endl;
+                    return false;
+                }
+                mDirs.emplace_back(Directory{wd, dir});
+            }
+#endif
+            mFiles.emplace_back(path);
+            return true;
+        }
+
+        [[maybe_unused]] void unwatch(const fs::path& file)
+        {
+            fs::path path = normalize(file);
+            auto it = std::find(mFiles.begin(), mFiles.end(), path);
+            if(it == mFiles.end())
+                return;
+            mFiles.erase(it);
+
+#ifdef __linux__
+            fs::path dir = path.parent_path();
+            bool dirStillUsed = std::any_of(mFiles.begin(), mFiles.end(), [&](const fs::path& f) { return f.parent_path() == dir; });
+            if(dirStillUsed)
+                return;
+
+            auto d = std::find_if(mDirs.begin(), mDirs.end(), [&](const Directory& e) { return e.mPath == dir; });
+            if(d != mDirs.end())
+            {
+                inotify_rm_watch(mFd, d->mWd);
+                mDirs.erase(d);
+            }
+#endif
+        }
+
+        // Drains all pending events and returns every watched file that changed, each once.
+        [[maybe_unused]] std::vector<fs::path> readChanges()
+        {
+            std::vector<fs::path> changed;
+#ifdef __linux__
+            alignas(inotify_event) char buffer[4096];
+            while(true)
+            {
+                ssize_t len = read(mFd, buffer, sizeof(buffer));
+                if(len <= 0)
+                    break;
+
+                for(char* ptr = buffer; ptr < buffer + len;)
+                {
+                    auto* event = reinterpret_cast<inotify_event*>(ptr);
+                    ptr += sizeof(inotify_event) + event->len;
+                    if(event->len == 0)
+                        continue;
+
+                    auto dir = std::find_if(mDirs.begin(), mDirs.end(), [&](const Directory& d) { return d.mWd == event->wd; });
+                    if(dir == mDirs.end())
+                        continue;
+
+                    fs::path path = dir->mPath / event->name;
+                    if(std::find(mFiles.begin(), mFiles.end(), path) != mFiles.end()
+                       && std::find(changed.begin(), changed.end(), path) == changed.end())
+                        changed.emplace_back(path);
+                }
+            }
+#endif
+            return changed;
+        }
+
+        [[maybe_unused]] static bool samePath(const fs::path& changed, const fs::path& file)
+        {
+            return changed == normalize(file);
+        }
+    };
+}
+#endif // LIST_WATCHER_HPP
@@ -0,0 +1,212 @@
+#ifndef LZ_HPP
+#define LZ_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+namespace Todo
+{
+    // Small LZ77 codec in the spirit of LZ4, used for archived lists. Input is cut into blocks of up to
+    // kBlockSize bytes that are compressed independently, each framed by
+    //
+    //     u32 raw size, u32 stored size (high bit set if the block is compressed), stored bytes
+    //
+    // so a reader can decode block by block with a bounded buffer or skip blocks it doesn't need.
+    // Inside a block a sequence is a token (literal count << 4 | match length - 4, 15 meaning more
+    // length bytes follow), the literals, and for all but the last sequence a two byte offset.
+    class Lz
+    {
+    public:
+        static constexpr std::size_t kBlockSize = 64 * 1024;
+        static constexpr std::size_t kFrameSize = 2 * sizeof(std::uint32_t);
+
+    private:
+        static constexpr std::size_t kMinMatch = 4;
+        static constexpr int kHashBits = 12;
+        static constexpr std::uint32_t kCompressed = 0x80000000u;
+
+        static std::uint32_t read32(const char* p)
+        {
+            std::uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        static std::uint32_t hash(const char* p)
+        {
+            return (read32(p) * 2654435761u) >> (32 - kHashBits);
+        }
+
+        static void appendLength(std::string& out, std::size_t length)
+        {
+            for(; length >= 255; length -= 255)
+                out += static_cast<char>(255);
+            out += static_cast<char>(length);
+        }
+
+        static void appendSequence(std::string& out, const char* literals, const std::size_t& literalCount,
+                                   const std::size_t& offset, const std::size_t& matchLength)
+        {
+            std::size_t matchCode = matchLength == 0 ? 0 : matchLength - kMinMatch;
+            out += static_cast<char>((std::min<std::size_t>(literalCount, 15) << 4) | std::min<std::size_t>(matchCode, 15));
+            if(literalCount >= 15)
+                appendLength(out, literalCount - 15);
+            out.append(literals, literalCount);
+            if(matchLength == 0)
+                return;
+            out += static_cast<char>(offset & 0xff);
+            out += static_cast<char>(offset >> 8);
+            if(matchCode >= 15)
+                appendLength(out, matchCode - 15);
+        }
+
+        static bool readLength(const unsigned char*& in, const unsigned char* end, std::size_t& length)
+        {
+            unsigned char byte;
+            do
+            {
+                if(in == end)
+                    return false;
+                byte = *in++;
+                length += byte;
+            } while(byte == 255);
+            return true;
+        }
+
+        // Compresses one block; returns false if the output wouldn't be smaller than the input.
+        static bool compressBlock(std::string_view input, std::string& out)
+        {
+            std::array<std::uint32_t, std::size_t(1) << kHashBits> table;
+            table.fill(UINT32_MAX);
+
+            std::size_t start = out.size();
+            const char* base = input.data();
+            std::size_t anchor = 0;
+            std::size_t position = 0;
+            // The last bytes are always literals, which keeps the match search inside the block.
+            std::size_t limit = input.size() > kMinMatch ? input.size() - kMinMatch : 0;
+            while(position < limit)
+            {
+                std::uint32_t h = hash(base + position);
+                std::uint32_t candidate = table[h];
+                table[h] = static_cast<std::uint32_t>(position);
+                if(candidate == UINT32_MAX || position - candidate > 0xffff || read32(base + candidate) != read32(base + position))
+                {
+                    position++;
+                    continue;
+                }
+
+                std::size_t length = kMinMatch;
+                while(position + length < input.size() && base[candidate + length] == base[position + length])
+                    length++;
+                appendSequence(out, base + anchor, position - anchor, position - candidate, length);
+                position += length;
+                anchor = position;
+                if(out.size() - start >= input.size())
+                    return false;
+            }
+            appendSequence(out, base + anchor, input.size() - anchor, 0, 0);
+            return out.size() - start < input.size();
+        }
+
+        static bool decompressBlock(std::string_view stored, const std::size_t& rawSize, std::string& out)
+        {
+            std::size_t start = out.size();
+            out.resize(start + rawSize);
+            char* dst = out.data() + start;
+            std::size_t written = 0;
+            auto in = reinterpret_cast<const unsigned char*>(stored.data());
+            const unsigned char* end = in + stored.size();
+            while(in < end)
+            {
+                unsigned char token = *in++;
+                std::size_t literals = token >> 4;
+                if(literals == 15 && !readLength(in, end, literals))
+                    return false;
+                if(literals > static_cast<std::size_t>(end - in) || literals > rawSize - written)
+                    return false;
+                std::memcpy(dst + written, in, literals);
+                in += literals;
+                written += literals;
+                if(in == end)
+                    break;
+
+                if(end - in < 2)
+                    return false;
+                std::size_t offset = in[0] | static_cast<std::size_t>(in[1]) << 8;
+                in += 2;
+                std::size_t length = token & 15;
+                if(length == 15 && !readLength(in, end, length))
+                    return false;
+                length += kMinMatch;
+                if(offset == 0 || offset > written || length > rawSize - written)
+                    return false;
+                // Overlapping matches repeat the last offset bytes, so copy byte by byte.
+                for(std::size_t i = 0; i < length; i++, written++)
+                    dst[written] = dst[written - offset];
+            }
+            return written == rawSize;
+        }
+
+    public:
+        // Appends input to out as a sequence of framed blocks.
+        [[maybe_unused]] static void compress(std::string_view input, std::string& out)
+        {
+            for(std::size_t offset = 0; offset < input.size(); offset += kBlockSize)
+            {
+                std::string_view block = input.substr(offset, kBlockSize);
+                std::size_t frame = out.size();
+                out.resize(frame + kFrameSize);
+
+                auto rawSize = static_cast<std::uint32_t>(block.size());
+                std::uint32_t stored = 0;
+                if(compressBlock(block, out))
+                    stored = static_cast<std::uint32_t>(out.size() - frame - kFrameSize) | kCompressed;
+                else
+                {
+                    out.resize(frame + kFrameSize);
+                    out.append(block);
+                    stored = rawSize;
+                }
+                std::memcpy(out.data() + frame, &rawSize, sizeof(rawSize));
+                std::memcpy(out.data() + frame + sizeof(rawSize), &stored, sizeof(stored));
+            }
+        }
+
+        // Decodes the block at the front of input, appends it to out and advances input past it.
+        // Returns false on a truncated or corrupt block.
+        [[maybe_unused]] static bool decodeBlock(std::string_view& input, std::string& out)
+        {
+            if(input.size() < kFrameSize)
+                return false;
+            std::uint32_t rawSize = read32(input.data());
+            std::uint32_t stored = read32(input.data() + sizeof(rawSize));
+            bool compressed = stored & kCompressed;
+            stored &= ~kCompressed;
+            if(rawSize > kBlockSize || stored > input.size() - kFrameSize)
+                return false;
+
+            std::string_view payload = input.substr(kFrameSize, stored);
+            input.remove_prefix(kFrameSize + stored);
+            if(compressed)
+                return decompressBlock(payload, rawSize, out);
+            if(stored != rawSize)
+                return false;
+            out.append(payload);
+            return true;
+        }
+
+        [[maybe_unused]] static bool decompress(std::string_view input, std::string& out)
+        {
+            while(!input.empty())
+                if(!decodeBlock(input, out))
+                    return false;
+            return true;
+        }
+    };
+}
+#endif // LZ_HPP
@@ -0,0 +1,252 @@
+#ifndef ORDER_TREE_HPP
+#define ORDER_TREE_HPP
+
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+
+namespace Todo
+{
+    // Display order of the entries of a list as an implicit treap: nodes are EntryStore slots, in-order
+    // position is the position in the list, and every node knows the size of its subtree. Positional
+    // lookup, insert, erase and the position of a slot are all O(log n) expected.
+    class OrderTree
+    {
+    public:
+        static constexpr std::uint32_t kNil = UINT32_MAX;
+
+    private:
+        struct Node
+        {
+            std::uint32_t mLeft;
+            std::uint32_t mRight;
+            std::uint32_t mParent;
+            std::uint32_t mSize;
+            std::uint32_t mPriority;
+        };
+
+        std::pmr::vector<Node> mNodes;
+        std::uint32_t mRoot;
+        std::uint32_t mSeed;
+        // True while the in-order sequence is increasing slots, i.e. nothing was inserted anywhere but
+        // the end. Lets callers walk the list as a plain scan over the slots.
+        bool mSorted;
+
+        std::uint32_t random()
+        {
+            mSeed ^= mSeed << 13;
+            mSeed ^= mSeed >> 17;
+            mSeed ^= mSeed << 5;
+            return mSeed;
+        }
+
+        std::uint32_t sizeOf(const std::uint32_t& node) const
+        {
+            return node == kNil ? 0 : mNodes[node].mSize;
+        }
+
+        void update(const std::uint32_t& node)
+        {
+            Node& n = mNodes[node];
+            n.mSize = 1 + sizeOf(n.mLeft) + sizeOf(n.mRight);
+            if(n.mLeft != kNil)
+                mNodes[n.mLeft].mParent = node;
+            if(n.mRight != kNil)
+                mNodes[n.mRight].mParent = node;
+        }
+
+        // Splits tree into the first count nodes and the rest. Node ids are taken by value because the
+        // outputs usually alias child links of the nodes being split.
+        void split(std::uint32_t tree, std::uint32_t count, std::uint32_t& left, std::uint32_t& right)
+        {
+            if(tree == kNil)
+            {
+                left = right = kNil;
+                return;
+            }
+
+            std::uint32_t leftSize = sizeOf(mNodes[tree].mLeft);
+            if(leftSize < count)
+            {
+                split(mNodes[tree].mRight, count - leftSize - 1, mNodes[tree].mRight, right);
+                left = tree;
+            }
+            else
+            {
+                split(mNodes[tree].mLeft, count, left, mNodes[tree].mLeft);
+                right = tree;
+            }
+            update(tree);
+            mNodes[tree].mParent = kNil;
+        }
+
+        std::uint32_t merge(std::uint32_t left, std::uint32_t right)
+        {
+            if(left == kNil)
+                return right;
+            if(right == kNil)
+                return left;
+
+            if(mNodes[left].mPriority > mNodes[right].mPriority)
+            {
+                mNodes[left].mRight = merge(mNodes[left].mRight, right);
+                update(left);
+                return left;
+            }
+            mNodes[right].mLeft = merge(left, mNodes[right].mLeft);
+            update(right);
+            return right;
+        }
+
+        void reset(const std::uint32_t& slot)
+        {
+            if(slot >= mNodes.size())
+                mNodes.resize(slot + 1, Node{kNil, kNil, kNil, 0, 0});
+            mNodes[slot] = Node{kNil, kNil, kNil, 1, random()};
+        }
+
+    public:
+        [[maybe_unused]] explicit OrderTree(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : mNodes(resource), mRoot(kNil), mSeed(0x9E3779B9u), mSorted(true)
+        {}
+
+        [[maybe_unused]] std::uint32_t size() const
+        {
+            return sizeOf(mRoot);
+        }
+
+        [[maybe_unused]] bool sorted() const
+        {
+            return mSorted;
+        }
+
+        // Builds the tree for slots 0..count-1 in that order in O(n), as a Cartesian tree over random
+        // priorities using the right spine as a stack.
+        [[maybe_unused]] void build(const std::uint32_t& count)
+        {
+            mNodes.clear();
+            mNodes.reserve(count);
+            mRoot = kNil;
+            mSorted = true;
+
+            std::pmr::vector<std::uint32_t> spine(mNodes.get_allocator());
+            for(std::uint32_t slot = 0; slot < count; slot++)
+            {
+                reset(slot);
+                std::uint32_t last = kNil;
+                while(!spine.empty() && mNodes[spine.back()].mPriority < mNodes[slot].mPriority)
+                {
+                    last = spine.back();
+                    spine.pop_back();
+                }
+                mNodes[slot].mLeft = last;
+                if(last != kNil)
+                    mNodes[last].mParent = slot;
+                if(!spine.empty())
+                {
+                    mNodes[spine.back()].mRight = slot;
+                    mNodes[slot].mParent = spine.back();
+                }
+                spine.emplace_back(slot);
+            }
+            if(count == 0)
+                return;
+
+            mRoot = spine.front();
+            // Parents come after their children in a post-order walk; compute sizes bottom up.
+            std::pmr::vector<std::uint32_t> order(mNodes.get_allocator());
+            order.reserve(count);
+            spine.assign(1, mRoot);
+            while(!spine.empty())
+            {
+                std::uint32_t node = spine.back();
+                spine.pop_back();
+                order.emplace_back(node);
+                if(mNodes[node].mLeft != kNil)
+                    spine.emplace_back(mNodes[node].mLeft);
+                if(mNodes[node].mRight != kNil)
+                    spine.emplace_back(mNodes[node].mRight);
+            }
+            for(auto it = order.rbegin(); it != order.rend(); ++it)
+                mNodes[*it].mSize = 1 + sizeOf(mNodes[*it].mLeft) + sizeOf(mNodes[*it].mRight);
+        }
+
+        [[maybe_unused]] void insert(const std::uint32_t& position, const std::uint32_t& slot)
+        {
+            if(mSorted && (position != size() || (size() > 0 && at(size() - 1) > slot)))
+                mSorted = false;
+            reset(slot);
+            std::uint32_t left;
+            std::uint32_t right;
+            split(mRoot, position, left, right);
+            mRoot = merge(merge(left, slot), right);
+            mNodes[mRoot].mParent = kNil;
+        }
+
+        [[maybe_unused]] void erase(const std::uint32_t& slot)
+        {
+            std::uint32_t position = positionOf(slot);
+            std::uint32_t left;
+            std::uint32_t middle;
+            std::uint32_t right;
+            split(mRoot, position, left, right);
+            split(right, 1, middle, right);
+            mRoot = merge(left, right);
+            if(mRoot != kNil)
+                mNodes[mRoot].mParent = kNil;
+        }
+
+        [[maybe_unused]] std::uint32_t at(std::uint32_t position) const
+        {
+            std::uint32_t node = mRoot;
+            while(node != kNil)
+            {
+                std::uint32_t leftSize = sizeOf(mNodes[node].mLeft);
+                if(position < leftSize)
+                    node = mNodes[node].mLeft;
+                else if(position == leftSize)
+                    return node;
+                else
+                {
+                    position -= leftSize + 1;
+                    node = mNodes[node].mRight;
+                }
+            }
+            return kNil;
+        }
+
+        [[maybe_unused]] std::uint32_t positionOf(std::uint32_t slot) const
+        {
+            std::uint32_t position = sizeOf(mNodes[slot].mLeft);
+            while(mNodes[slot].mParent != kNil)
+            {
+                std::uint32_t parent = mNodes[slot].mParent;
+                if(mNodes[parent].mRight == slot)
+                    position += sizeOf(mNodes[parent].mLeft) + 1;
+                slot = parent;
+            }
+            return position;
+        }
+
+        // In-order successor, kNil after the last slot. Walking the whole list this way is O(n).
+        [[maybe_unused]] std::uint32_t next(std::uint32_t slot) const
+        {
+            if(mNodes[slot].mRight != kNil)
+            {
+                slot = mNodes[slot].mRight;
+                while(mNodes[slot].mLeft != kNil)
+                    slot = mNodes[slot].mLeft;
+                return slot;
+            }
+            while(mNodes[slot].mParent != kNil && mNodes[mNodes[slot].mParent].mRight == slot)
+                slot = mNodes[slot].mParent;
+            return mNodes[slot].mParent;
+        }
+
+        [[maybe_unused]] std::uint32_t first() const
+        {
+            return at(0);
+        }
+    };
+}
+#endif // ORDER_TREE_HPP
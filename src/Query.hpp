@@ -0,0 +1,310 @@
+#ifndef QUERY_HPP
+#define QUERY_HPP
+
+#include "TodoList.hpp"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Todo
+{
+    struct Match
+    {
+        std::uint32_t mPosition;
+        std::uint32_t mSlot;
+    };
+
+    // Filter over the entries of a list, compiled from a line of space separated terms:
+    //
+    //     state:open | state:done          completion state
+    //     prefix:<text>                    description starts with text
+    //     after:<YYYY-MM-DD>               created on or after that day (UTC)
+    //     before:<YYYY-MM-DD>              created before that day (UTC)
+    //     sort:position | sort:created | sort:-created | sort:text
+    //     limit:<n>  offset:<n>
+    //     <word>                           description contains word (case sensitive)
+    //
+    // Terms are ANDed. compile() turns them into a plan whose steps run cheapest first, so the state
+    // bits and the creation time rule most entries out before any text is looked at. Running a query
+    // only writes into the caller's result vector; nothing is allocated per entry.
+    class Query
+    {
+    public:
+        enum class Sort
+        {
+            position,
+            created,
+            createdDescending,
+            text
+        };
+
+    private:
+        // Declared in evaluation order.
+        enum class Kind
+        {
+            createdAfter,
+            createdBefore,
+            prefix,
+            substring
+        };
+
+        struct Step
+        {
+            Kind mKind;
+            std::int64_t mValue;
+            std::string mText;
+        };
+
+        enum class State
+        {
+            any,
+            open,
+            done
+        };
+
+        State mState;
+        std::vector<Step> mPlan;
+        Sort mSort;
+        std::size_t mLimit;
+        std::size_t mOffset;
+
+        // memchr finds candidates for the first byte of the needle with the library's vectorized
+        // scan; only those are compared in full.
+        static bool contains(std::string_view haystack, std::string_view needle)
+        {
+            if(needle.empty())
+                return true;
+            if(needle.size() > haystack.size())
+                return false;
+
+            const char* it = haystack.data();
+            const char* last = haystack.data() + haystack.size() - needle.size();
+            while(it <= last)
+            {
+                it = static_cast<const char*>(std::memchr(it, needle[0], static_cast<std::size_t>(last - it) + 1));
+                if(!it)
+                    return false;
+                if(std::memcmp(it + 1, needle.data() + 1, needle.size() - 1) == 0)
+                    return true;
+                it++;
+            }
+            return false;
+        }
+
+        template<typename T>
+        static bool parseNumber(std::string_view text, T& value)
+        {
+            auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+            return ec == std::errc() && ptr == text.data() + text.size();
+        }
+
+        // The completion state is not part of the plan; run() applies it first, to whole bitset words
+        // where it can.
+        bool matches(const EntryStore& store, const std::uint32_t& slot) const
+        {
+            for(const Step& step : mPlan)
+            {
+                bool pass = true;
+                switch(step.mKind)
+                {
+                    case Kind::createdAfter:
+                        pass = store.created(slot) >= step.mValue;
+                        break;
+                    case Kind::createdBefore:
+                        pass = store.created(slot) < step.mValue;
+                        break;
+                    case Kind::prefix:
+                        pass = store.text(slot).starts_with(step.mText);
+                        break;
+                    case Kind::substring:
+                        pass = contains(store.text(slot), step.mText);
+                        break;
+                }
+                if(!pass)
+                    return false;
+            }
+            return true;
+        }
+
+    public:
+        [[maybe_unused]] Query()
+        : mState(State::any), mPlan(), mSort(Sort::position), mLimit(SIZE_MAX), mOffset(0)
+        {}
+
+        // Parses YYYY-MM-DD into seconds since the epoch at midnight UTC.
+        [[maybe_unused]] static bool parseDay(std::string_view text, std::int64_t& seconds)
+        {
+            int year = 0;
+            unsigned month = 0;
+            unsigned day = 0;
+            if(text.size() != 10 || text[4] != '-' || text[7] != '-' || !parseNumber(text.substr(0, 4), year)
+               || !parseNumber(text.substr(5, 2), month) || !parseNumber(text.substr(8, 2), day))
+                return false;
+
+            std::chrono::year_month_day date{std::chrono::year(year), std::chrono::month(month), std::chrono::day(day)};
+            if(!date.ok())
+                return false;
+            seconds = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::sys_days(date).time_since_epoch()).count();
+            return true;
+        }
+
+        // Returns false and describes the offending term in error if the query can't be compiled.
+        [[maybe_unused]] bool compile(std::string_view input, std::string& error)
+        {
+            mState = State::any;
+            mPlan.clear();
+            mSort = Sort::position;
+            mLimit = SIZE_MAX;
+            mOffset = 0;
+
+            while(!input.empty())
+            {
+                std::size_t len = input.find(' ');
+                std::string_view term = input.substr(0, len);
+                input.remove_prefix(len == std::string_view::npos ? input.size() : len + 1);
+                if(term.empty())
+                    continue;
+
+                std::size_t colon = term.find(':');
+                std::string_view key = colon == std::string_view::npos ? std::string_view() : term.substr(0, colon);
+                std::string_view value = colon == std::string_view::npos ? term : term.substr(colon + 1);
+
+                bool ok = true;
+                if(key == "state")
+                {
+                    ok = value == "open" || value == "done";
+                    mState = value == "done" ? State::done : State::open;
+                }
+                else if(key == "prefix")
+                    mPlan.push_back(Step{Kind::prefix, 0, std::string(value)});
+                else if(key == "after" || key == "before")
+                {
+                    std::int64_t seconds = 0;
+                    ok = parseDay(value, seconds);
+                    mPlan.push_back(Step{key == "after" ? Kind::createdAfter : Kind::createdBefore, seconds, {}});
+                }
+                else if(key == "limit")
+                    ok = parseNumber(value, mLimit);
+                else if(key == "offset")
+                    ok = parseNumber(value, mOffset);
+                else if(key == "sort")
+                {
+                    if(value == "position")
+                        mSort = Sort::position;
+                    else if(value == "created")
+                        mSort = Sort::created;
+                    else if(value == "-created")
+                        mSort = Sort::createdDescending;
+                    else if(value == "text")
+                        mSort = Sort::text;
+                    else
+                        ok = false;
+                }
+                else
+                    mPlan.push_back(Step{Kind::substring, 0, std::string(term)});
+
+                if(!ok)
+                {
+                    error = "Invalid filter term[" + std::string(term) + "]";
+                    return false;
+                }
+            }
+
+            // Longer needles rule out more entries, so among the text steps they go first.
+            std::stable_sort(mPlan.begin(), mPlan.end(), [](const Step& a, const Step& b)
+            {
+                if(a.mKind != b.mKind)
+                    return a.mKind < b.mKind;
+                return a.mText.size() > b.mText.size();
+            });
+            return true;
+        }
+
+        // Fills out with the matching entries in result order, after offset and limit were applied.
+        [[maybe_unused]] void run(const List& list, std::vector<Match>& out) const
+        {
+            out.clear();
+            const EntryStore& store = list.store();
+
+            // In list order the scan can stop as soon as the requested page is complete.
+            std::size_t wanted = mLimit > SIZE_MAX - mOffset ? SIZE_MAX : mOffset + mLimit;
+            std::size_t stopAt = mSort == Sort::position ? wanted : SIZE_MAX;
+            if(list.order().sorted())
+            {
+                // Slot order is list order: scan the bitsets word by word, the position of an entry is
+                // the number of live slots before it.
+                const auto& live = store.liveBits();
+                const auto& done = store.doneBits();
+                std::uint32_t position = 0;
+                for(std::size_t word = 0; word < live.size() && out.size() < stopAt; word++)
+                {
+                    std::uint64_t candidates = live[word];
+                    if(mState == State::open)
+                        candidates &= ~done[word];
+                    else if(mState == State::done)
+                        candidates &= done[word];
+
+                    while(candidates != 0 && out.size() < stopAt)
+                    {
+                        int bit = std::countr_zero(candidates);
+                        candidates &= candidates - 1;
+                        auto slot = static_cast<std::uint32_t>(word * 64 + static_cast<std::size_t>(bit));
+                        if(matches(store, slot))
+                        {
+                            std::uint64_t before = live[word] & ((std::uint64_t(1) << bit) - 1);
+                            out.push_back(Match{position + static_cast<std::uint32_t>(std::popcount(before)), slot});
+                        }
+                    }
+                    position += static_cast<std::uint32_t>(std::popcount(live[word]));
+                }
+            }
+            else
+            {
+                bool wantDone = mState == State::done;
+                for(std::uint32_t slot = list.order().first(), position = 0; slot != OrderTree::kNil && out.size() < stopAt;
+                    slot = list.order().next(slot), position++)
+                {
+                    if((mState == State::any || store.done(slot) == wantDone) && matches(store, slot))
+                        out.push_back(Match{position, slot});
+                }
+            }
+
+            auto less = [&](const Match& a, const Match& b)
+            {
+                switch(mSort)
+                {
+                    case Sort::created:
+                        if(store.created(a.mSlot) != store.created(b.mSlot))
+                            return store.created(a.mSlot) < store.created(b.mSlot);
+                        break;
+                    case Sort::createdDescending:
+                        if(store.created(a.mSlot) != store.created(b.mSlot))
+                            return store.created(a.mSlot) > store.created(b.mSlot);
+                        break;
+                    case Sort::text:
+                        if(store.text(a.mSlot) != store.text(b.mSlot))
+                            return store.text(a.mSlot) < store.text(b.mSlot);
+                        break;
+                    case Sort::position:
+                        break;
+                }
+                return a.mPosition < b.mPosition;
+            };
+
+            if(mSort != Sort::position)
+            {
+                // Only the requested page has to be in order.
+                std::size_t end = std::min(wanted, out.size());
+                std::partial_sort(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(end), out.end(), less);
+                out.resize(end);
+            }
+            out.erase(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(std::min(mOffset, out.size())));
+        }
+    };
+}
+#endif // QUERY_HPP
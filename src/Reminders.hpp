@@ -0,0 +1,497 @@
+#ifndef REMINDERS_HPP
+#define REMINDERS_HPP
+
+#include "../dependencies/FileHandler.hpp"
+#include "FileLock.hpp"
+#include "Query.hpp"
+#include "TimingWheel.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Todo
+{
+    struct Reminder
+    {
+        std::uint32_t mList;
+        std::uint32_t mEntry;
+        std::int64_t mDue;
+        std::uint32_t mInterval; // seconds between repeats, 0 for a one-off reminder
+        std::uint32_t mHandle;   // timer in the wheel, TimingWheel::kNil for a free slot
+    };
+
+    // Due dates of entries in all lists, kept in data/reminders.bin and scheduled on a TimingWheel.
+    // The file is a log of fixed-size records: set and cancel keyed by a hash of the list path and the
+    // entry id, plus one record per list that maps the hash back to its path. Loading replays it into
+    // the wheel without opening a single list; other instances' records are picked up whenever this
+    // one writes. compact() replaces the log with a shorter one once most of it is outdated; the header
+    // then carries a new generation, which tells other instances to replay it from the start rather than
+    // from where they stopped reading the old one. Writers lock data/reminders.lock, which unlike the log
+    // itself is never replaced.
+    class Reminders
+    {
+    private:
+        struct Header
+        {
+            char mMagic[4];
+            std::uint32_t mGeneration;
+        };
+        static_assert(sizeof(Header) == 8);
+        static constexpr char kMagic[4] = {'T', 'D', 'R', '2'};
+
+        struct Record
+        {
+            char mType; // 'L' list path follows (mEntry bytes), 'A' set, 'C' cancel
+            char mReserved[3];
+            std::uint32_t mEntry;
+            std::uint64_t mList;
+            std::int64_t mDue;
+            std::uint32_t mInterval;
+            std::uint32_t mReserved2;
+        };
+        static_assert(sizeof(Record) == 32);
+
+        struct ListInfo
+        {
+            std::uint64_t mHash;
+            std::string mPath;
+        };
+
+        fs::path mPath;
+        fs::path mLockPath;
+        std::vector<ListInfo> mLists;
+        std::unordered_map<std::uint64_t, std::uint32_t> mListIndex; // path hash -> index in mLists
+        std::vector<Reminder> mReminders;
+        std::vector<std::uint32_t> mFree;
+        std::unordered_map<std::uint64_t, std::uint32_t> mByEntry; // list index << 32 | entry id -> reminder
+        TimingWheel mWheel;
+        std::string mPending;
+        std::size_t mPendingRecords;
+        std::string mReadBuffer;
+        std::uintmax_t mFileSize;
+        std::uint32_t mGeneration;
+        std::size_t mRecords;
+
+        static std::string normalize(const fs::path& list)
+        {
+            return list.lexically_normal().generic_string();
+        }
+
+        static std::uint64_t hashOf(std::string_view path)
+        {
+            std::uint64_t hash = 14695981039346656037ull;
+            for(unsigned char c : path)
+            {
+                hash ^= c;
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        static std::uint64_t key(const std::uint32_t& list, const std::uint32_t& entry)
+        {
+            return static_cast<std::uint64_t>(list) << 32 | entry;
+        }
+
+        std::uint32_t addList(const std::uint64_t& hash, std::string_view path)
+        {
+            auto it = mListIndex.find(hash);
+            if(it != mListIndex.end())
+                return it->second;
+            auto index = static_cast<std::uint32_t>(mLists.size());
+            mLists.push_back(ListInfo{hash, std::string(path)});
+            mListIndex.emplace(hash, index);
+            return index;
+        }
+
+        // Index of list, announcing it in the log the first time it is seen.
+        std::uint32_t listIndex(const fs::path& list)
+        {
+            std::string path = normalize(list);
+            std::uint64_t hash = hashOf(path);
+            if(mListIndex.contains(hash))
+                return mListIndex[hash];
+
+            appendRecord('L', hash, static_cast<std::uint32_t>(path.size()), 0, 0);
+            mPending += path;
+            return addList(hash, path);
+        }
+
+        void appendRecord(const char& type, const std::uint64_t& list, const std::uint32_t& entry,
+                          const std::int64_t& due, const std::uint32_t& interval)
+        {
+            Record record{type, {}, entry, list, due, interval, 0};
+            mPending.append(reinterpret_cast<const char*>(&record), sizeof(record));
+            mPendingRecords++;
+        }
+
+        void setLocal(const std::uint32_t& list, const std::uint32_t& entry, const std::int64_t& due, const std::uint32_t& interval)
+        {
+            auto [it, inserted] = mByEntry.try_emplace(key(list, entry), 0);
+            if(inserted)
+            {
+                if(!mFree.empty())
+                {
+                    it->second = mFree.back();
+                    mFree.pop_back();
+                }
+                else
+                {
+                    it->second = static_cast<std::uint32_t>(mReminders.size());
+                    mReminders.emplace_back();
+                }
+            }
+            else
+                mWheel.cancel(mReminders[it->second].mHandle);
+
+            mReminders[it->second] = Reminder{list, entry, due, interval, mWheel.schedule(due, it->second)};
+        }
+
+        bool cancelLocal(const std::uint32_t& list, const std::uint32_t& entry)
+        {
+            auto it = mByEntry.find(key(list, entry));
+            if(it == mByEntry.end())
+                return false;
+            Reminder& reminder = mReminders[it->second];
+            mWheel.cancel(reminder.mHandle);
+            reminder.mHandle = TimingWheel::kNil;
+            mFree.push_back(it->second);
+            mByEntry.erase(it);
+            return true;
+        }
+
+        // Applies the records in buffer and returns how many bytes formed complete records.
+        std::size_t replay(std::string_view buffer)
+        {
+            std::size_t offset = 0;
+            while(offset + sizeof(Record) <= buffer.size())
+            {
+                Record record;
+                std::memcpy(&record, buffer.data() + offset, sizeof(record));
+                if(record.mType == 'L')
+                {
+                    if(offset + sizeof(Record) + record.mEntry > buffer.size())
+                        break;
+                    addList(record.mList, buffer.substr(offset + sizeof(Record), record.mEntry));
+                    offset += record.mEntry;
+                }
+                else
+                {
+                    auto list = mListIndex.find(record.mList);
+                    if(list != mListIndex.end() && record.mType == 'A')
+                        setLocal(list->second, record.mEntry, record.mDue, record.mInterval);
+                    else if(list != mListIndex.end() && record.mType == 'C')
+                        cancelLocal(list->second, record.mEntry);
+                }
+                offset += sizeof(Record);
+                mRecords++;
+            }
+            return offset;
+        }
+
+        static void prependHeader(std::string& out, const std::uint32_t& generation)
+        {
+            Header header{{}, generation};
+            std::memcpy(header.mMagic, kMagic, sizeof(kMagic));
+            out.insert(0, reinterpret_cast<const char*>(&header), sizeof(header));
+        }
+
+        // Forgets everything read from the log, for replaying a replaced one from the start.
+        void reset()
+        {
+            mLists.clear();
+            mListIndex.clear();
+            mReminders.clear();
+            mFree.clear();
+            mByEntry.clear();
+            mWheel = TimingWheel(mWheel.now());
+            mFileSize = 0;
+            mRecords = 0;
+        }
+
+        // Applies what other instances appended since we last looked, or all of the log if it was
+        // replaced or shrank in the meantime. Expects the lock to be held.
+        bool syncLocked()
+        {
+            std::error_code ec;
+            std::uintmax_t size = fs::file_size(mPath, ec);
+            if(ec || size < sizeof(Header))
+                return false;
+
+            std::ifstream inStream(mPath, std::ios::binary);
+            Header header;
+            if(!inStream.read(reinterpret_cast<char*>(&header), sizeof(header))
+               || std::memcmp(header.mMagic, kMagic, sizeof(kMagic)) != 0)
+                return false;
+            bool replaced = header.mGeneration != mGeneration || size < mFileSize;
+            if(replaced)
+            {
+                reset();
+                mGeneration = header.mGeneration;
+            }
+
+            std::uintmax_t offset = std::max<std::uintmax_t>(mFileSize, sizeof(Header));
+            if(size <= offset)
+                return replaced;
+
+            mReadBuffer.resize(size - offset);
+            inStream.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+            inStream.read(mReadBuffer.data(), static_cast<std::streamsize>(mReadBuffer.size()));
+            mReadBuffer.resize(static_cast<std::size_t>(inStream.gcount()));
+            // A record another instance is still writing is read again next time.
+            mFileSize = offset + replay(mReadBuffer);
+            return true;
+        }
+
+    public:
+        [[maybe_unused]] explicit Reminders(const fs::path& path)
+        : mPath(path), mLockPath(fs::path(path).replace_extension(".lock")), mLists(), mListIndex(), mReminders(),
+          mFree(), mByEntry(), mWheel(now()), mPending(), mPendingRecords(0), mReadBuffer(), mFileSize(0),
+          mGeneration(0), mRecords(0)
+        {}
+
+        Reminders(const Reminders&) = delete;
+        Reminders& operator=(const Reminders&) = delete;
+
+        static std::int64_t now()
+        {
+            auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+            return std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch).count();
+        }
+
+        // Accepts YYYY-MM-DD, YYYY-MM-DDTHH:MM (UTC) or an offset from now like +30m, +2h, +1d.
+        [[maybe_unused]] static bool parseWhen(std::string_view text, std::int64_t& when)
+        {
+            std::uint32_t offset = 0;
+            if(text.starts_with('+'))
+            {
+                if(!parseInterval(text.substr(1), offset))
+                    return false;
+                when = now() + offset;
+                return true;
+            }
+
+            if(!Query::parseDay(text.substr(0, 10), when))
+                return false;
+            if(text.size() == 10)
+                return true;
+
+            unsigned hour = 0;
+            unsigned minute = 0;
+            if(text.size() != 16 || text[10] != 'T' || text[13] != ':'
+               || std::from_chars(text.data() + 11, text.data() + 13, hour).ptr != text.data() + 13
+               || std::from_chars(text.data() + 14, text.data() + 16, minute).ptr != text.data() + 16 || hour > 23 || minute > 59)
+                return false;
+            when += hour * 3600 + minute * 60;
+            return true;
+        }
+
+        // Accepts a count followed by s, m, h, d or w.
+        [[maybe_unused]] static bool parseInterval(std::string_view text, std::uint32_t& seconds)
+        {
+            if(text.size() < 2)
+                return false;
+            std::uint32_t count = 0;
+            auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size() - 1, count);
+            if(ec != std::errc() || ptr != text.data() + text.size() - 1 || count == 0)
+                return false;
+
+            std::uint32_t unit = 0;
+            switch(text.back())
+            {
+                case 's': unit = 1; break;
+                case 'm': unit = 60; break;
+                case 'h': unit = 3600; break;
+                case 'd': unit = 86400; break;
+                case 'w': unit = 604800; break;
+                default: return false;
+            }
+            if(count > UINT32_MAX / unit)
+                return false;
+            seconds = count * unit;
+            return true;
+        }
+
+        [[maybe_unused]] static std::string formatTime(const std::int64_t& time)
+        {
+            std::chrono::sys_seconds point{std::chrono::seconds(time)};
+            auto days = std::chrono::floor<std::chrono::days>(point);
+            std::chrono::year_month_day date{days};
+            std::chrono::hh_mm_ss clock{point - days};
+            char text[32];
+            std::snprintf(text, sizeof(text), "%04d-%02u-%02u %02d:%02d UTC", static_cast<int>(date.year()),
+                          static_cast<unsigned>(date.month()), static_cast<unsigned>(date.day()),
+                          static_cast<int>(clock.hours().count()), static_cast<int>(clock.minutes().count()));
+            return text;
+        }
+
+        [[maybe_unused]] bool load()
+        {
+            FileLock lock(mLockPath, LockMode::shared);
+            syncLocked();
+            return true;
+        }
+
+        // Writes the pending records in one append after merging records of other instances.
+        [[maybe_unused]] bool flush()
+        {
+            if(mPending.empty())
+                return true;
+
+            FileLock lock(mLockPath, LockMode::exclusive);
+            if(lock.failed())
+                return false;
+            std::string pending;
+            pending.swap(mPending);
+            // Records of other instances are older than ours, so ours are applied again on top. That
+            // also brings them back if the log was replaced and replayed from the start.
+            if(syncLocked())
+                replay(pending);
+            else
+                mRecords += mPendingRecords;
+            mPendingRecords = 0;
+
+            std::error_code ec;
+            std::uintmax_t size = fs::file_size(mPath, ec);
+            if(ec || size < sizeof(Header))
+            {
+                // A new log starts with a generation none of the instances has seen yet.
+                mGeneration = static_cast<std::uint32_t>(now());
+                prependHeader(pending, mGeneration);
+            }
+            if(!FileHandler::WriteToFile(mPath, pending, std::ios::app))
+                return false;
+            mFileSize = fs::file_size(mPath, ec);
+            return true;
+        }
+
+        [[maybe_unused]] void set(const fs::path& list, const std::uint32_t& entry, const std::int64_t& due,
+                                  const std::uint32_t& interval)
+        {
+            std::uint32_t index = listIndex(list);
+            appendRecord('A', mLists[index].mHash, entry, due, interval);
+            setLocal(index, entry, due, interval);
+        }
+
+        [[maybe_unused]] bool cancel(const fs::path& list, const std::uint32_t& entry)
+        {
+            auto it = mListIndex.find(hashOf(normalize(list)));
+            if(it == mListIndex.end() || !cancelLocal(it->second, entry))
+                return false;
+            appendRecord('C', mLists[it->second].mHash, entry, 0, 0);
+            return true;
+        }
+
+        [[maybe_unused]] const Reminder* find(const fs::path& list, const std::uint32_t& entry) const
+        {
+            auto it = mListIndex.find(hashOf(normalize(list)));
+            if(it == mListIndex.end())
+                return nullptr;
+            auto reminder = mByEntry.find(key(it->second, entry));
+            return reminder == mByEntry.end() ? nullptr : &mReminders[reminder->second];
+        }
+
+        [[maybe_unused]] const std::string& listPath(const Reminder& reminder) const
+        {
+            return mLists[reminder.mList].mPath;
+        }
+
+        [[maybe_unused]] std::size_t size() const
+        {
+            return mByEntry.size();
+        }
+
+        // Calls fn(reminder) for every reminder of list. Looks at all reminders, so it is meant for
+        // showing them, not for the hot path.
+        template<typename F>
+        void forList(const fs::path& list, F&& fn) const
+        {
+            auto it = mListIndex.find(hashOf(normalize(list)));
+            if(it == mListIndex.end())
+                return;
+            for(auto& [entryKey, index] : mByEntry)
+            {
+                if(mReminders[index].mList == it->second)
+                    fn(mReminders[index]);
+            }
+        }
+
+        // Fires everything due up to now: fire(reminder) is called once per reminder, even if a
+        // repeating one was missed several times. Repeating reminders move on to their next due time
+        // after now, the others are removed. The resulting records go out in one write.
+        template<typename F>
+        void advance(const std::int64_t& now, F&& fire)
+        {
+            mWheel.advance(now, [&](const std::uint32_t& index, const std::int64_t&)
+            {
+                Reminder reminder = mReminders[index];
+                reminder.mHandle = TimingWheel::kNil;
+                if(reminder.mInterval > 0)
+                {
+                    std::int64_t missed = (now - reminder.mDue) / reminder.mInterval + 1;
+                    std::int64_t due = reminder.mDue + missed * reminder.mInterval;
+                    appendRecord('A', mLists[reminder.mList].mHash, reminder.mEntry, due, reminder.mInterval);
+                    setLocal(reminder.mList, reminder.mEntry, due, reminder.mInterval);
+                }
+                else
+                {
+                    // The wheel already dropped the timer.
+                    mReminders[index].mHandle = TimingWheel::kNil;
+                    mFree.push_back(index);
+                    mByEntry.erase(key(reminder.mList, reminder.mEntry));
+                    appendRecord('C', mLists[reminder.mList].mHash, reminder.mEntry, 0, 0);
+                }
+                fire(reminder);
+            });
+            flush();
+        }
+
+        // Replaces the log with one set record per pending reminder once it mostly holds outdated ones.
+        // The new log is written next to the old one and renamed over it, so readers see either.
+        [[maybe_unused]] bool compact()
+        {
+            flush();
+            FileLock lock(mLockPath, LockMode::exclusive);
+            if(lock.failed())
+                return false;
+            syncLocked();
+            if(mRecords <= std::max<std::size_t>(1024, 2 * size()))
+                return true;
+
+            std::string out;
+            prependHeader(out, mGeneration + 1);
+            for(const ListInfo& list : mLists)
+            {
+                Record record{'L', {}, static_cast<std::uint32_t>(list.mPath.size()), list.mHash, 0, 0, 0};
+                out.append(reinterpret_cast<const char*>(&record), sizeof(record));
+                out += list.mPath;
+            }
+            for(auto& [entryKey, index] : mByEntry)
+            {
+                const Reminder& reminder = mReminders[index];
+                Record record{'A', {}, reminder.mEntry, mLists[reminder.mList].mHash, reminder.mDue, reminder.mInterval, 0};
+                out.append(reinterpret_cast<const char*>(&record), sizeof(record));
+            }
+
+            fs::path temp = mPath;
+            temp += ".tmp";
+            if(!FileHandler::WriteToFile(temp, out))
+                return false;
+            std::error_code ec;
+            fs::rename(temp, mPath, ec);
+            if(ec)
+            {
+                std::cerr << "Failed to replace: " << mPath << " : " << ec.message() << std::endl;
+                return false;
+            }
+            mGeneration++;
+            mFileSize = out.size();
+            mRecords = mLists.size() + size();
+            return true;
+        }
+    };
+}
+#endif // REMINDERS_HPP
@@ -0,0 +1,78 @@
+#ifndef SELECTION_HPP
+#define SELECTION_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Todo
+{
+    // Parses a selection of 1-based positions as typed after done/undone: single numbers, ranges like
+    // 1-500 and the word all, separated by commas or spaces ("3,7,9", "1-5 8"). Fills positions with
+    // the selected 0-based positions in ascending order, each once. Nothing is selected unless every
+    // term is valid for a list of count entries; otherwise error names the first bad term.
+    inline bool parseSelection(std::string_view text, const std::size_t& count, std::vector<std::uint32_t>& positions,
+                               std::string& error)
+    {
+        positions.clear();
+        auto number = [&](std::string_view digits, std::size_t& value)
+        {
+            auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), value);
+            return ec == std::errc() && ptr == digits.data() + digits.size() && value >= 1 && value <= count;
+        };
+
+        bool any = false;
+        while(!text.empty())
+        {
+            std::size_t len = text.find_first_of(", ");
+            std::string_view term = text.substr(0, len);
+            text.remove_prefix(len == std::string_view::npos ? text.size() : len + 1);
+            if(term.empty())
+                continue;
+            any = true;
+
+            std::size_t first = 0;
+            std::size_t last = 0;
+            std::size_t dash = term.find('-');
+            bool ok = false;
+            if(term == "all")
+            {
+                first = 1;
+                last = count;
+                ok = count > 0;
+            }
+            else if(dash == std::string_view::npos)
+            {
+                ok = number(term, first);
+                last = first;
+            }
+            else
+                ok = number(term.substr(0, dash), first) && number(term.substr(dash + 1), last) && first <= last;
+
+            if(!ok)
+            {
+                error = "Invalid index[" + std::string(term) + "]";
+                positions.clear();
+                return false;
+            }
+            for(std::size_t position = first; position <= last; position++)
+                positions.emplace_back(static_cast<std::uint32_t>(position - 1));
+        }
+
+        if(!any)
+        {
+            error = "No index was given";
+            return false;
+        }
+
+        // Terms are usually typed in order already.
+        if(!std::is_sorted(positions.begin(), positions.end()))
+            std::sort(positions.begin(), positions.end());
+        positions.erase(std::unique(positions.begin(), positions.end()), positions.end());
+        return true;
+    }
+}
+#endif // SELECTION_HPP
@@ -0,0 +1,428 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include "Archive.hpp"
+#include "Session.hpp"
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Wire format shared by the daemon and the client. A request is one command line terminated by '\n',
+// exactly as it would be typed interactively. Every request gets one response:
+//
+//     '+' or '-' (success / failure), payload length in decimal, '\n', payload bytes
+//
+// Clients may send any number of requests before reading; responses come back in request order.
+namespace Todo
+{
+    constexpr std::size_t kMaxRequestLine = 1 << 20;
+    constexpr std::size_t kMaxPendingOutput = 4 << 20;
+
+    inline void appendResponse(std::string& out, const bool& ok, const std::string_view& payload)
+    {
+        out += ok ? '+' : '-';
+        out += std::to_string(payload.size());
+        out += '\n';
+        out += payload;
+    }
+
+#ifdef __linux__
+    // Single threaded epoll daemon keeping the catalog and every list a client opened in memory.
+    class Server
+    {
+    private:
+        struct Connection
+        {
+            int mFd;
+            std::string mIn;
+            std::string mOut;
+            std::size_t mOutOffset;
+            Session mSession;
+            std::uint32_t mEvents;
+        };
+
+        fs::path mSocketPath;
+        const fs::path& mDirPath;
+        Catalog& mCatalog;
+        Archive& mArchive;
+        Reminders& mReminders;
+        HotLists mLists;
+        int mListenFd;
+        int mEpollFd;
+        std::unordered_map<int, std::unique_ptr<Connection>> mConnections;
+        std::string mScratch;
+
+        // Stops reading from clients that don't collect their responses, and from closed sessions that
+        // only wait for their last responses to drain.
+        void updateInterest(Connection& conn)
+        {
+            std::size_t pending = conn.mOut.size() - conn.mOutOffset;
+            bool reading = !conn.mSession.closed() && pending <= kMaxPendingOutput;
+            std::uint32_t events = (reading ? static_cast<std::uint32_t>(EPOLLIN | EPOLLRDHUP) : 0) | (pending > 0 ? static_cast<std::uint32_t>(EPOLLOUT) : 0);
+            if(events == conn.mEvents)
+                return;
+
+            epoll_event ev{};
+            ev.events = events;
+            ev.data.fd = conn.mFd;
+            epoll_ctl(mEpollFd, EPOLL_CTL_MOD, conn.mFd, &ev);
+            conn.mEvents = events;
+        }
+
+        void closeConnection(const int& fd)
+        {
+            epoll_ctl(mEpollFd, EPOLL_CTL_DEL, fd, nullptr);
+            close(fd);
+            mConnections.erase(fd);
+        }
+
+        void acceptConnections()
+        {
+            while(true)
+            {
+                int fd = accept4(mListenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                if(fd < 0)
+                    return;
+
+                auto conn = std::unique_ptr<Connection>(new Connection{fd, {}, {}, 0, Session(mDirPath, mCatalog, mArchive, mReminders, mLists), EPOLLIN | EPOLLRDHUP});
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLRDHUP;
+                ev.data.fd = fd;
+                if(epoll_ctl(mEpollFd, EPOLL_CTL_ADD, fd, &ev) < 0)
+                {
+                    close(fd);
+                    continue;
+                }
+                mConnections.emplace(fd, std::move(conn));
+            }
+        }
+
+        // Answers every complete request in the input buffer, so pipelined requests cost one read and
+        // one write for the whole batch.
+        void processRequests(Connection& conn)
+        {
+            std::size_t begin = 0;
+            std::size_t end;
+            while(!conn.mSession.closed() && (end = conn.mIn.find('\n', begin)) != std::string::npos)
+            {
+                mScratch.clear();
+                bool ok = conn.mSession.execute(std::string_view(conn.mIn).substr(begin, end - begin), mScratch);
+                appendResponse(conn.mOut, ok, mScratch);
+                begin = end + 1;
+            }
+            conn.mIn.erase(0, begin);
+        }
+
+        // Returns false once the connection is done and has been closed.
+        bool flush(Connection& conn)
+        {
+            while(conn.mOutOffset < conn.mOut.size())
+            {
+                ssize_t len = send(conn.mFd, conn.mOut.data() + conn.mOutOffset, conn.mOut.size() - conn.mOutOffset, MSG_NOSIGNAL);
+                if(len < 0)
+                {
+                    if(errno == EINTR)
+                        continue;
+                    if(errno == EAGAIN || errno == EWOULDBLOCK)
+                        break;
+                    closeConnection(conn.mFd);
+                    return false;
+                }
+                conn.mOutOffset += static_cast<std::size_t>(len);
+            }
+
+            if(conn.mOutOffset == conn.mOut.size())
+            {
+                conn.mOut.clear();
+                conn.mOutOffset = 0;
+                if(conn.mSession.closed())
+                {
+                    closeConnection(conn.mFd);
+                    return false;
+                }
+            }
+            updateInterest(conn);
+            return true;
+        }
+
+        void onReadable(Connection& conn)
+        {
+            char buffer[64 * 1024];
+            bool hangup = false;
+            while(true)
+            {
+                ssize_t len = recv(conn.mFd, buffer, sizeof(buffer), 0);
+                if(len > 0)
+                {
+                    conn.mIn.append(buffer, static_cast<std::size_t>(len));
+                    if(static_cast<std::size_t>(len) < sizeof(buffer))
+                        break;
+                    continue;
+                }
+                if(len < 0 && errno == EINTR)
+                    continue;
+                if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    break;
+                hangup = true;
+                break;
+            }
+
+            processRequests(conn);
+            if(conn.mIn.size() > kMaxRequestLine)
+            {
+                appendResponse(conn.mOut, false, "Request too long\n");
+                conn.mIn.clear();
+                hangup = true;
+            }
+
+            // A client that half-closed still gets the responses to everything it sent.
+            if(hangup && !conn.mSession.closed())
+            {
+                if(!conn.mIn.empty())
+                {
+                    conn.mIn += '\n';
+                    processRequests(conn);
+                }
+                conn.mSession.execute("exit", mScratch);
+            }
+            flush(conn);
+        }
+
+    public:
+        [[maybe_unused]] Server(const fs::path& socketPath, const fs::path& dirPath, Catalog& catalog, Archive& archive,
+                                     Reminders& reminders)
+        : mSocketPath(socketPath), mDirPath(dirPath), mCatalog(catalog), mArchive(archive), mReminders(reminders), mLists(), mListenFd(-1), mEpollFd(-1),
+          mConnections(), mScratch()
+        {}
+
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        ~Server()
+        {
+            for(auto& [fd, conn] : mConnections)
+                close(fd);
+            if(mEpollFd >= 0)
+                close(mEpollFd);
+            if(mListenFd >= 0)
+            {
+                close(mListenFd);
+                unlink(mSocketPath.c_str());
+            }
+        }
+
+        [[maybe_unused]] bool listen()
+        {
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            if(mSocketPath.string().size() >= sizeof(addr.sun_path))
+            {
+                std::cerr << "Failed to listen: socket path too long: " << mSocketPath << std::endl;
+                return false;
+            }
+            std::strcpy(addr.sun_path, mSocketPath.c_str());
+
+            if(!mSocketPath.parent_path().empty())
+                fs::create_directories(mSocketPath.parent_path());
+
+            mListenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if(mListenFd < 0)
+            {
+                std::cerr << "Failed to create socket : " << std::strerror(errno) << std::endl;
+                return false;
+            }
+
+            // A socket file nobody accepts on is left over from a daemon that didn't shut down cleanly.
+            if(fs::exists(mSocketPath))
+            {
+                int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+                bool alive = connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+                close(probe);
+                if(alive)
+                {
+                    std::cerr << "Failed to listen: another daemon is serving " << mSocketPath << std::endl;
+                    return false;
+                }
+                unlink(mSocketPath.c_str());
+            }
+
+            if(bind(mListenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || ::listen(mListenFd, SOMAXCONN) < 0)
+            {
+                std::cerr << "Failed to listen on: " << mSocketPath << " : " << std::strerror(errno) << std::endl;
+                close(mListenFd);
+                mListenFd = -1;
+                return false;
+            }
+
+            mEpollFd = epoll_create1(EPOLL_CLOEXEC);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.fd = mListenFd;
+            epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mListenFd, &ev);
+            return true;
+        }
+
+        // Serves clients until stopFd, if given, becomes readable.
+        [[maybe_unused]] void run(const int& stopFd = -1)
+        {
+            if(stopFd >= 0)
+            {
+                epoll_event ev{};
+                ev.events = EPOLLIN;
+                ev.data.fd = stopFd;
+                epoll_ctl(mEpollFd, EPOLL_CTL_ADD, stopFd, &ev);
+            }
+
+            epoll_event events[256];
+            while(true)
+            {
+                int count = epoll_wait(mEpollFd, events, 256, -1);
+                if(count < 0)
+                {
+                    if(errno == EINTR)
+                        continue;
+                    std::cerr << "Failed to wait for events : " << std::strerror(errno) << std::endl;
+                    return;
+                }
+
+                for(int i = 0; i < count; i++)
+                {
+                    int fd = events[i].data.fd;
+                    if(fd == stopFd)
+                        return;
+                    if(fd == mListenFd)
+                    {
+                        acceptConnections();
+                        continue;
+                    }
+
+                    auto it = mConnections.find(fd);
+                    if(it == mConnections.end())
+                        continue;
+                    Connection& conn = *it->second;
+
+                    if(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                        onReadable(conn);
+                    else if(events[i].events & EPOLLOUT)
+                        flush(conn);
+                }
+            }
+        }
+    };
+
+    // Thin client: forwards stdin line by line to the daemon without waiting for answers and prints the
+    // responses as they arrive, payloads of failed requests on stderr.
+    [[maybe_unused]] inline int runClient(const fs::path& socketPath)
+    {
+        sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        if(socketPath.string().size() >= sizeof(addr.sun_path))
+        {
+            std::cerr << "Failed to connect: socket path too long: " << socketPath << std::endl;
+            return 1;
+        }
+        std::strcpy(addr.sun_path, socketPath.c_str());
+
+        int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(sock < 0 || connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            std::cerr << "Failed to connect to: " << socketPath << " : " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+
+        std::string out;
+        std::string in;
+        std::size_t outstanding = 0;
+        bool inputOpen = true;
+        int status = 0;
+        char buffer[64 * 1024];
+
+        while(inputOpen || outstanding > 0 || !out.empty())
+        {
+            // Only whole lines go out; a line still being typed waits for its newline. Sends never block,
+            // so responses keep being read while the daemon holds back on a client that is behind, and
+            // stdin rests while too much of it is still unsent.
+            std::size_t complete = inputOpen ? out.rfind('\n') + 1 : out.size();
+            bool reading = inputOpen && out.size() <= kMaxPendingOutput;
+            pollfd fds[2] = {{sock, static_cast<short>(POLLIN | (complete == 0 ? 0 : POLLOUT)), 0},
+                             {reading ? STDIN_FILENO : -1, POLLIN, 0}};
+            if(poll(fds, 2, -1) < 0)
+            {
+                if(errno == EINTR)
+                    continue;
+                break;
+            }
+
+            if(fds[1].revents & (POLLIN | POLLHUP))
+            {
+                ssize_t len = read(STDIN_FILENO, buffer, sizeof(buffer));
+                if(len <= 0)
+                {
+                    inputOpen = false;
+                    if(!out.empty() && !out.ends_with('\n'))
+                    {
+                        out += '\n';
+                        outstanding++;
+                    }
+                }
+                else
+                {
+                    for(ssize_t i = 0; i < len; i++)
+                        if(buffer[i] == '\n')
+                            outstanding++;
+                    out.append(buffer, static_cast<std::size_t>(len));
+                }
+            }
+
+            if((fds[0].revents & POLLOUT) && complete > 0)
+            {
+                ssize_t len = send(sock, out.data(), complete, MSG_NOSIGNAL | MSG_DONTWAIT);
+                if(len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    break;
+                if(len > 0)
+                    out.erase(0, static_cast<std::size_t>(len));
+            }
+
+            if(fds[0].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                ssize_t len = recv(sock, buffer, sizeof(buffer), 0);
+                if(len <= 0)
+                    break;
+                in.append(buffer, static_cast<std::size_t>(len));
+
+                std::size_t begin = 0;
+                while(true)
+                {
+                    std::size_t header = in.find('\n', begin);
+                    if(header == std::string::npos)
+                        break;
+                    std::size_t size = std::strtoull(in.c_str() + begin + 1, nullptr, 10);
+                    if(in.size() - header - 1 < size)
+                        break;
+
+                    bool ok = in[begin] == '+';
+                    (ok ? std::cout : std::cerr) << std::string_view(in).substr(header + 1, size) << std::flush;
+                    if(!ok)
+                        status = 1;
+                    if(outstanding > 0)
+                        outstanding--;
+                    begin = header + 1 + size;
+                }
+                in.erase(0, begin);
+            }
+        }
+
+        close(sock);
+        return status;
+    }
+#endif
+}
+#endif // SERVER_HPP
@@ -0,0 +1,520 @@
+#ifndef SESSION_HPP
+#define SESSION_HPP
+
+#include "Archive.hpp"
+#include "BulkIO.hpp"
+#include "Catalog.hpp"
+#include "Query.hpp"
+#include "Reminders.hpp"
+#include "Selection.hpp"
+#include "TodoList.hpp"
+#include <algorithm>
+#include <charconv>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+namespace Todo
+{
+    // A loaded list and the number of sessions that have it open.
+    struct HotList
+    {
+        std::unique_ptr<List> mList;
+        std::size_t mSessions;
+    };
+
+    using HotLists = std::unordered_map<std::string, HotList>;
+
+    // Runs the command set for the terminal and for each daemon client. Output goes into a buffer
+    // instead of the console, and lists stay loaded in the shared HotLists between requests and clients
+    // while any session has them open.
+    class Session
+    {
+    private:
+        const fs::path& mDirPath;
+        Catalog& mCatalog;
+        Archive& mArchive;
+        Reminders& mReminders;
+        HotLists& mLists;
+        std::string mOpen;
+        bool mClosed;
+        Query mQuery;
+        std::vector<Match> mMatches;
+        std::vector<std::uint32_t> mPositions;
+        std::string mTerminator; // set while the lines of an add <<END block are collected
+        std::vector<std::string> mBlock;
+        bool mEcho; // daemon clients get changed entries back; the terminal redraws the whole list instead
+
+        static std::string next(std::string_view& input)
+        {
+            std::size_t len = input.find(' ');
+            std::string token(input.substr(0, len));
+            input.remove_prefix(len == std::string_view::npos ? input.size() : len + 1);
+            return token;
+        }
+
+        fs::path listPath(const std::string& name) const
+        {
+            fs::path path = mDirPath;
+            path += name;
+            path += ".txt";
+            return path;
+        }
+
+        // The open list stays loaded; a reload is only a stat unless someone else wrote to the file.
+        List& hotList()
+        {
+            List& list = *mLists.at(mOpen).mList;
+            list.reload();
+            return list;
+        }
+
+        // Makes name the open list, loading it unless another session has it open already.
+        List* enterList(const std::string& name)
+        {
+            auto it = mLists.find(name);
+            if(it == mLists.end())
+            {
+                auto list = std::make_unique<List>();
+                if(!mArchive.promote(mCatalog, listPath(name)) || !list->load(listPath(name)))
+                    return nullptr;
+                it = mLists.emplace(name, HotList{std::move(list), 0}).first;
+            }
+            else
+                it->second.mList->reload();
+
+            it->second.mSessions++;
+            closeList();
+            mOpen = name;
+            return it->second.mList.get();
+        }
+
+        // Leaves the open list. The last session to leave folds its journal into the list file and
+        // unloads it, so the daemon only keeps lists in memory that someone works on.
+        void closeList()
+        {
+            auto it = mLists.find(mOpen);
+            mOpen.clear();
+            if(it == mLists.end())
+                return;
+
+            it->second.mList->compact();
+            if(--it->second.mSessions == 0)
+                mLists.erase(it);
+        }
+
+        static void printEntries(const List& list, std::string& out)
+        {
+            list.forEach([&](const std::size_t& position, const std::uint32_t& slot)
+            {
+                list.store().format(slot, out, position + 1);
+                out += '\n';
+            });
+        }
+
+        static std::uint32_t entryId(const List& list, const std::size_t& index)
+        {
+            return list.store().id(list.order().at(static_cast<std::uint32_t>(index)));
+        }
+
+        void echo(const List& list, const std::size_t& position, std::string& out) const
+        {
+            if(!mEcho)
+                return;
+            list.format(position, out);
+            out += '\n';
+        }
+
+        // Parses a 1-based position as used on screen.
+        static bool position(const std::string& number, std::size_t& index)
+        {
+            auto [ptr, ec] = std::from_chars(number.data(), number.data() + number.size(), index);
+            if(ec != std::errc() || ptr != number.data() + number.size() || index == 0)
+                return false;
+            index--;
+            return true;
+        }
+
+        bool menuCommand(const std::string& command, std::string_view args, std::string& out)
+        {
+            if(command == "list")
+            {
+                std::size_t count = 1;
+                for(auto& listing : mCatalog.listings())
+                {
+                    std::string name = listing.mPath.filename().string();
+                    name.erase(name.end() - 4, name.end());
+                    out += std::to_string(count++) + " : " + name + (listing.mTier == Tier::cold ? " (archived)\n" : "\n");
+                }
+                return true;
+            }
+            else if(command == "add")
+            {
+                std::string name = next(args);
+                if(name.empty())
+                {
+                    out += "No name for the todo list was given!\nUse of add: add [name]\n";
+                    return false;
+                }
+
+                fs::path path = listPath(name);
+                if(fs::exists(path) || mCatalog.tier(path) == Tier::cold)
+                {
+                    out += "Failed to create new todo list with name[" + name + "]. this list already exist\n";
+                    return false;
+                }
+                if(!FileHandler::CreateFile(path))
+                {
+                    out += "Failed to create new todo list with name[" + name + "]\n";
+                    return false;
+                }
+
+                mCatalog.add(path);
+                mCatalog.save();
+                return true;
+            }
+            else if(command == "open")
+            {
+                std::string name = next(args);
+                List* list = name.empty() ? nullptr : enterList(name);
+                if(!list)
+                {
+                    out += "Failed to open list with name[" + name + "]. This list doesn't exist\n";
+                    return false;
+                }
+
+                if(!mEcho)
+                    return true;
+                std::size_t done = list->store().doneCount();
+                out += "Todo list: " + name + " (" + std::to_string(list->size() - done) + " open, "
+                       + std::to_string(done) + " done)\n";
+                printEntries(*list, out);
+                return true;
+            }
+
+            out += "Unknown command[" + command + "]\n";
+            return false;
+        }
+
+        bool listCommand(const std::string& command, std::string_view args, std::string& out)
+        {
+            if(command == "close")
+            {
+                closeList();
+                return true;
+            }
+
+            List* list = &hotList();
+
+            if(command == "add" && args.starts_with("<<"))
+            {
+                mTerminator = args.size() > 2 ? std::string(args.substr(2)) : std::string("EOF");
+                mBlock.clear();
+                return true;
+            }
+            else if(command == "add")
+            {
+                if(args.empty())
+                {
+                    out += "Failed to add an entry!\nUse of add: add [description]\n";
+                    return false;
+                }
+
+                if(!list->add(args))
+                {
+                    out += "Failed to add entry\n";
+                    return false;
+                }
+                echo(*list, list->size() - 1, out);
+                return true;
+            }
+            else if(command == "insert")
+            {
+                std::size_t index = 0;
+                std::string number = next(args);
+                if(!position(number, index) || args.empty())
+                {
+                    out += "Failed to insert an entry!\nUse of insert: insert [index] [description]\n";
+                    return false;
+                }
+
+                index = std::min(index, list->size());
+                if(!list->insert(static_cast<std::uint32_t>(index), args))
+                {
+                    out += "Failed to insert entry\n";
+                    return false;
+                }
+                echo(*list, index, out);
+                return true;
+            }
+            else if(command == "done" || command == "undone")
+            {
+                std::string error;
+                if(!parseSelection(args, list->size(), mPositions, error))
+                {
+                    out += error + "\nUse of " + command + ": " + command + " [index|from-to|all],...\n";
+                    return false;
+                }
+                bool done = command == "done";
+                if(!list->setDone(mPositions, done) && !list->isDone(mPositions, done))
+                {
+                    out += "failed to mark entries as " + command + "!\n";
+                    return false;
+                }
+
+                // Finished entries don't need reminding anymore. The daemon doesn't watch the reminder log,
+                // so reminders other instances set are picked up first.
+                if(done && mReminders.load() && mReminders.size() > 0)
+                {
+                    bool cancelled = false;
+                    for(std::uint32_t index : mPositions)
+                        cancelled |= mReminders.cancel(list->path(), entryId(*list, index));
+                    if(cancelled)
+                        mReminders.flush();
+                }
+
+                for(std::uint32_t index : mPositions)
+                    echo(*list, index, out);
+                return true;
+            }
+            else if(command == "find" || command == "filter")
+            {
+                std::string error;
+                if(!mQuery.compile(args, error))
+                {
+                    out += error + '\n';
+                    return false;
+                }
+
+                mQuery.run(*list, mMatches);
+                for(auto& match : mMatches)
+                {
+                    list->store().format(match.mSlot, out, match.mPosition + 1);
+                    out += '\n';
+                }
+                return true;
+            }
+            else if(command == "import" || command == "export")
+            {
+                Format format;
+                fs::path file(args);
+                if(args.empty() || !formatOf(file, format))
+                {
+                    out += "Failed to " + command + "!\nUse of " + command + ": " + command + " [file.txt|file.csv|file.jsonl]\n";
+                    return false;
+                }
+
+                if(command == "export")
+                {
+                    if(!exportEntries(*list, file, format))
+                    {
+                        out += "Failed to export entries to[" + file.string() + "]\n";
+                        return false;
+                    }
+                    out += "Exported " + std::to_string(list->size()) + " entries\n";
+                    return true;
+                }
+
+                std::size_t imported = 0;
+                std::size_t skipped = 0;
+                Importer importer(format);
+                if(!importer.run(list->path(), file, imported, skipped))
+                {
+                    out += "Failed to import entries from[" + file.string() + "]\n";
+                    return false;
+                }
+                list->reload();
+                out += "Imported " + std::to_string(imported) + " entries, skipped " + std::to_string(skipped) + '\n';
+                return true;
+            }
+            else if(command == "del")
+            {
+                std::size_t index = 0;
+                std::string number = next(args);
+                std::uint32_t id = position(number, index) && index < list->size() ? entryId(*list, index) : 0;
+                if(id == 0 || !list->remove(index))
+                {
+                    out += "failed to delete entry! no entry with index[" + number + "]\n";
+                    return false;
+                }
+                if(mReminders.load() && mReminders.cancel(list->path(), id))
+                    mReminders.flush();
+                return true;
+            }
+            else if(command == "due" && args.empty())
+            {
+                mReminders.load();
+                mReminders.forList(list->path(), [&](const Reminder& reminder)
+                {
+                    std::uint32_t slot = list->slotOf(reminder.mEntry);
+                    if(slot == OrderTree::kNil)
+                        return;
+                    out += "Due " + Reminders::formatTime(reminder.mDue) + ": ";
+                    list->store().format(slot, out, list->order().positionOf(slot) + 1);
+                    if(reminder.mInterval > 0)
+                        out += " (every " + std::to_string(reminder.mInterval) + "s)";
+                    out += '\n';
+                });
+                return true;
+            }
+            else if(command == "due" || command == "undue")
+            {
+                std::size_t index = 0;
+                std::string number = next(args);
+                if(!position(number, index) || index >= list->size())
+                {
+                    out += "failed to set due date! no entry with index[" + number + "]\n";
+                    return false;
+                }
+                std::uint32_t id = entryId(*list, index);
+                mReminders.load();
+
+                if(command == "undue")
+                {
+                    if(!mReminders.cancel(list->path(), id))
+                    {
+                        out += "Entry[" + number + "] has no due date\n";
+                        return false;
+                    }
+                    return mReminders.flush();
+                }
+
+                std::string when = next(args);
+                std::string every = next(args);
+                std::int64_t due = 0;
+                std::uint32_t repeat = 0;
+                if(!Reminders::parseWhen(when, due) || (!every.empty() && (every != "every" || !Reminders::parseInterval(args, repeat))))
+                {
+                    out += "Failed to set due date!\nUse of due: due [index] [YYYY-MM-DD|YYYY-MM-DDTHH:MM|+30m|+2h|+1d] [every 1d]\n";
+                    return false;
+                }
+
+                mReminders.set(list->path(), id, due, repeat);
+                if(!mReminders.flush())
+                {
+                    out += "Failed to save the due date of entry[" + number + "]\n";
+                    return false;
+                }
+                out += "Entry[" + number + "] is due " + Reminders::formatTime(due) + '\n';
+                return true;
+            }
+            else if(command == "move")
+            {
+                std::size_t from = 0;
+                std::size_t to = 0;
+                std::string fromNumber = next(args);
+                std::string toNumber = next(args);
+                if(!position(fromNumber, from) || !position(toNumber, to) || !list->move(from, to))
+                {
+                    out += "failed to move entry!\nUse of move: move [index] [index]\n";
+                    return false;
+                }
+
+                echo(*list, to, out);
+                return true;
+            }
+
+            out += "Unknown command[" + command + "]\n";
+            return false;
+        }
+
+        bool collect(std::string_view line, std::string& out)
+        {
+            if(line != mTerminator)
+            {
+                if(!line.empty())
+                    mBlock.emplace_back(line);
+                return true;
+            }
+            mTerminator.clear();
+
+            List* list = &hotList();
+            if(mBlock.empty() || !list->addAll(mBlock))
+            {
+                out += "Failed to add entries!\nUse of add: add <<[END] followed by one description per line and END\n";
+                return false;
+            }
+            for(std::size_t index = list->size() - mBlock.size(); index < list->size(); index++)
+                echo(*list, index, out);
+            mBlock.clear();
+            return true;
+        }
+
+    public:
+        [[maybe_unused]] Session(const fs::path& dirPath, Catalog& catalog, Archive& archive, Reminders& reminders, HotLists& lists,
+                                 const bool& echo = true)
+        : mDirPath(dirPath), mCatalog(catalog), mArchive(archive), mReminders(reminders), mLists(lists), mOpen(), mClosed(false), mQuery(), mMatches(), mPositions(),
+          mTerminator(), mBlock(), mEcho(echo)
+        {}
+
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+
+        ~Session()
+        {
+            closeList();
+        }
+
+        // Executes one request line and appends its output to out. Returns false if the command failed.
+        // The lines of an add <<END block are requests of their own that are answered empty; the
+        // terminator adds them all at once and carries the result.
+        [[maybe_unused]] bool execute(std::string_view line, std::string& out)
+        {
+            if(line.ends_with('\r'))
+                line.remove_suffix(1);
+
+            if(!mTerminator.empty())
+                return collect(line, out);
+
+            std::string command = next(line);
+            if(command == "exit")
+            {
+                closeList();
+                mClosed = true;
+                return true;
+            }
+
+            // A name the file system refuses fails its command instead of ending the session.
+            try
+            {
+                if(mOpen.empty())
+                    return menuCommand(command, line, out);
+                return listCommand(command, line, out);
+            }
+            catch(const fs::filesystem_error& e)
+            {
+                out += "Failed to " + command + " : " + e.what() + '\n';
+                return false;
+            }
+        }
+
+        [[maybe_unused]] bool closed() const
+        {
+            return mClosed;
+        }
+
+        // The list that is open, without reloading it; nullptr at the menu.
+        [[maybe_unused]] List* openList() const
+        {
+            auto it = mLists.find(mOpen);
+            return it == mLists.end() ? nullptr : it->second.mList.get();
+        }
+
+        [[maybe_unused]] const std::string& openName() const
+        {
+            return mOpen;
+        }
+
+        // The terminator of the add <<END block being collected, empty otherwise.
+        [[maybe_unused]] const std::string& terminator() const
+        {
+            return mTerminator;
+        }
+
+        [[maybe_unused]] const std::vector<Match>& matches() const
+        {
+            return mMatches;
+        }
+    };
+}
+#endif // SESSION_HPP
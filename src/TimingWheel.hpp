@@ -0,0 +1,210 @@
+#ifndef TIMING_WHEEL_HPP
+#define TIMING_WHEEL_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+namespace Todo
+{
+    // Hierarchical timing wheel with one second resolution: four levels of 256 slots cover 2^32
+    // seconds ahead, later deadlines wait in an overflow list. Timers are nodes in one vector, linked
+    // into their slot, so schedule and cancel are O(1). advance() only visits slots that hold timers:
+    // an occupancy bitmap per level lets it jump over empty stretches, and a higher level slot is
+    // cascaded into the lower levels once per rotation of the level below it.
+    class TimingWheel
+    {
+    public:
+        static constexpr std::uint32_t kNil = UINT32_MAX;
+
+    private:
+        static constexpr int kLevels = 4;
+        static constexpr int kSlotBits = 8;
+        static constexpr std::uint32_t kSlots = 1u << kSlotBits;
+        static constexpr std::uint16_t kOverflow = kLevels * kSlots;
+
+        struct Node
+        {
+            std::int64_t mTime;
+            std::uint32_t mPrev;
+            std::uint32_t mNext;
+            std::uint32_t mPayload;
+            std::uint16_t mBucket; // level * kSlots + slot, kOverflow or kFree
+        };
+
+        static constexpr std::uint16_t kFree = kOverflow + 1;
+
+        std::vector<Node> mNodes;
+        std::uint32_t mFreeList;
+        std::array<std::uint32_t, kLevels * kSlots + 1> mHeads;
+        std::array<std::array<std::uint64_t, kSlots / 64>, kLevels> mOccupied;
+        std::int64_t mNow;
+        std::size_t mSize;
+
+        // Bucket for a deadline at or after mNow.
+        std::uint16_t bucketFor(const std::int64_t& time) const
+        {
+            // The lowest level whose rotation still contains time: all higher bits match mNow.
+            auto diff = static_cast<std::uint64_t>(time ^ mNow);
+            for(int level = 0; level < kLevels; level++)
+            {
+                if((diff >> (kSlotBits * (level + 1))) == 0)
+                    return static_cast<std::uint16_t>(level * kSlots + ((time >> (kSlotBits * level)) & (kSlots - 1)));
+            }
+            return kOverflow;
+        }
+
+        void link(const std::uint32_t& node, const std::uint16_t& bucket)
+        {
+            Node& n = mNodes[node];
+            n.mBucket = bucket;
+            n.mPrev = kNil;
+            n.mNext = mHeads[bucket];
+            if(n.mNext != kNil)
+                mNodes[n.mNext].mPrev = node;
+            mHeads[bucket] = node;
+            if(bucket < kOverflow)
+                mOccupied[bucket / kSlots][(bucket % kSlots) / 64] |= std::uint64_t(1) << (bucket % 64);
+        }
+
+        void unlink(const std::uint32_t& node)
+        {
+            Node& n = mNodes[node];
+            if(n.mPrev != kNil)
+                mNodes[n.mPrev].mNext = n.mNext;
+            else
+                mHeads[n.mBucket] = n.mNext;
+            if(n.mNext != kNil)
+                mNodes[n.mNext].mPrev = n.mPrev;
+            if(mHeads[n.mBucket] == kNil && n.mBucket < kOverflow)
+                mOccupied[n.mBucket / kSlots][(n.mBucket % kSlots) / 64] &= ~(std::uint64_t(1) << (n.mBucket % 64));
+        }
+
+        // First occupied slot of level at or after from, or -1.
+        int nextOccupied(const int& level, const std::uint32_t& from) const
+        {
+            for(std::uint32_t word = from / 64; word < kSlots / 64; word++)
+            {
+                std::uint64_t bits = mOccupied[level][word];
+                if(word == from / 64)
+                    bits &= ~std::uint64_t(0) << (from % 64);
+                if(bits != 0)
+                    return static_cast<int>(word * 64 + static_cast<std::uint32_t>(std::countr_zero(bits)));
+            }
+            return -1;
+        }
+
+        // Moves every timer of a bucket to where it belongs relative to mNow. Runs before the level 0
+        // slot of mNow is fired, so timers due right now still land in it.
+        void redistribute(const std::uint16_t& bucket)
+        {
+            std::uint32_t node = mHeads[bucket];
+            mHeads[bucket] = kNil;
+            if(bucket < kOverflow)
+                mOccupied[bucket / kSlots][(bucket % kSlots) / 64] &= ~(std::uint64_t(1) << (bucket % 64));
+            while(node != kNil)
+            {
+                std::uint32_t next = mNodes[node].mNext;
+                link(node, bucketFor(std::max(mNodes[node].mTime, mNow)));
+                node = next;
+            }
+        }
+
+        // mNow just reached a multiple of 256: bring down the slots of every level that turned over,
+        // highest first so their timers can fall all the way through.
+        void cascade()
+        {
+            int level = 1;
+            while(level < kLevels && ((mNow >> (kSlotBits * level)) & (kSlots - 1)) == 0)
+                level++;
+            if(level == kLevels)
+                redistribute(kOverflow);
+            for(int l = std::min(level, kLevels - 1); l >= 1; l--)
+                redistribute(static_cast<std::uint16_t>(l * kSlots + ((mNow >> (kSlotBits * l)) & (kSlots - 1))));
+        }
+
+    public:
+        [[maybe_unused]] explicit TimingWheel(const std::int64_t& now = 0)
+        : mNodes(), mFreeList(kNil), mHeads(), mOccupied(), mNow(now), mSize(0)
+        {
+            mHeads.fill(kNil);
+        }
+
+        [[maybe_unused]] std::size_t size() const
+        {
+            return mSize;
+        }
+
+        [[maybe_unused]] std::int64_t now() const
+        {
+            return mNow;
+        }
+
+        // Returns a handle for cancel(). Deadlines that already passed fire on the next advance().
+        [[maybe_unused]] std::uint32_t schedule(const std::int64_t& time, const std::uint32_t& payload)
+        {
+            std::uint32_t node = mFreeList;
+            if(node != kNil)
+                mFreeList = mNodes[node].mNext;
+            else
+            {
+                node = static_cast<std::uint32_t>(mNodes.size());
+                mNodes.emplace_back();
+            }
+
+            mNodes[node].mTime = time;
+            mNodes[node].mPayload = payload;
+            link(node, bucketFor(std::max(time, mNow + 1)));
+            mSize++;
+            return node;
+        }
+
+        [[maybe_unused]] void cancel(const std::uint32_t& handle)
+        {
+            if(handle >= mNodes.size() || mNodes[handle].mBucket == kFree)
+                return;
+            unlink(handle);
+            mNodes[handle].mBucket = kFree;
+            mNodes[handle].mNext = mFreeList;
+            mFreeList = handle;
+            mSize--;
+        }
+
+        // Moves the wheel forward to now and calls fire(payload, time) for every timer that came due,
+        // in deadline order. Timers may be scheduled and cancelled from inside fire.
+        template<typename F>
+        void advance(const std::int64_t& now, F&& fire)
+        {
+            while(mNow < now)
+            {
+                // Jump to the next occupied level 0 slot, or to the end of this rotation.
+                std::int64_t base = mNow & ~static_cast<std::int64_t>(kSlots - 1);
+                std::uint32_t from = static_cast<std::uint32_t>(mNow & (kSlots - 1)) + 1;
+                int slot = from < kSlots ? nextOccupied(0, from) : -1;
+                std::int64_t next = slot >= 0 ? base + slot : base + kSlots;
+                if(next > now)
+                {
+                    mNow = now;
+                    break;
+                }
+
+                mNow = next;
+                if((mNow & (kSlots - 1)) == 0)
+                    cascade();
+
+                auto bucket = static_cast<std::uint16_t>(mNow & (kSlots - 1));
+                while(mHeads[bucket] != kNil)
+                {
+                    std::uint32_t node = mHeads[bucket];
+                    std::uint32_t payload = mNodes[node].mPayload;
+                    std::int64_t time = mNodes[node].mTime;
+                    cancel(node);
+                    fire(payload, time);
+                }
+            }
+        }
+    };
+}
+#endif // TIMING_WHEEL_HPP
@@ -0,0 +1,910 @@
+#ifndef TODO_LIST_HPP
+#define TODO_LIST_HPP
+
+#include "../dependencies/FileHandler.hpp"
+#include "EntryStore.hpp"
+#include "FileLock.hpp"
+#include "OrderTree.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace Todo
+{
+    struct ReloadResult
+    {
+        bool mChanged = false;
+        bool mFullRedraw = false;
+        std::vector<std::size_t> mChangedLines;
+        std::size_t mFirstAppended = 0;
+        std::size_t mAppendedCount = 0;
+    };
+
+    using Entry = std::pmr::string;
+
+    // An open todo list. On disk a list is a snapshot in the usual text format (foo.txt, where the
+    // number in front of each line is the entry's stable id) plus a journal of the changes made since
+    // (foo.journal), so deleting or moving an entry appends one record instead of rewriting the file:
+    //
+    //     + <id> <after id> <created> <text>     new entry behind <after id>, 0 for the front
+    //     d <id>                                 marked done
+    //     u <id>                                 marked open again
+    //     - <id>                                 deleted
+    //     m <id> <after id>                      moved behind <after id>
+    //
+    // Records refer to ids rather than positions, so they stay valid when other tools append lines to
+    // the snapshot. compact() folds the journal back into the snapshot and keeps the creation times of
+    // its entries in foo.meta. It replaces foo.txt rather than rewriting it, so a file that is still the
+    // same one and only grew had lines appended, and just those are parsed on reload.
+    //
+    // Entries live in an EntryStore and their order in an OrderTree. Both, like all scratch buffers,
+    // come from a per-list pool: small blocks such as the id map's nodes are recycled between reloads,
+    // large ones like the text and column arrays go straight back to the heap when a reload replaces
+    // them, and closing the list hands the rest back in one step.
+    class List
+    {
+    private:
+        static constexpr std::size_t kCompactThreshold = 4096;
+        static constexpr char kMetaMagic[4] = {'T', 'D', 'M', '1'};
+        static constexpr std::size_t kTailSize = 256;
+
+        struct State
+        {
+            EntryStore mStore;
+            OrderTree mOrder;
+            std::pmr::unordered_map<std::uint32_t, std::uint32_t> mSlots; // id -> slot
+            std::uint32_t mNextId;
+
+            explicit State(std::pmr::memory_resource* resource)
+            : mStore(resource), mOrder(resource), mSlots(resource), mNextId(1)
+            {}
+        };
+
+        std::pmr::unsynchronized_pool_resource mPool;
+        fs::path mPath;
+        fs::path mJournalPath;
+        fs::path mMetaPath;
+        State mState;
+        Entry mReadBuffer;
+        Entry mWriteBuffer;
+        // How much of the files on disk is reflected in mState. Used to tell our own writes apart from
+        // external ones and to replay only the records appended to the journal since.
+        std::uintmax_t mSnapshotSize;
+        fs::file_time_type mSnapshotWriteTime;
+        std::uint64_t mSnapshotFile;
+        Entry mSnapshotTail; // last bytes in front of mSnapshotSize, to tell an append from a rewrite
+        std::uintmax_t mMetaSize;
+        std::uintmax_t mJournalSize;
+        std::size_t mJournalRecords;
+
+        static bool readRange(const fs::path& path, const std::uintmax_t& offset, const std::uintmax_t& count, Entry& buffer)
+        {
+            std::ifstream inStream(path, std::ios::binary);
+            if(!inStream.is_open())
+                return false;
+
+            buffer.resize(count);
+            inStream.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+            inStream.read(buffer.data(), static_cast<std::streamsize>(count));
+            buffer.resize(static_cast<std::size_t>(inStream.gcount()));
+            return buffer.size() == count;
+        }
+
+        static std::int64_t now()
+        {
+            auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+            return std::chrono::duration_cast<std::chrono::seconds>(sinceEpoch).count();
+        }
+
+        static std::int64_t toSeconds(const fs::file_time_type& time)
+        {
+            auto sys = std::chrono::file_clock::to_sys(time);
+            return std::chrono::duration_cast<std::chrono::seconds>(sys.time_since_epoch()).count();
+        }
+
+        // Inode number of the file at path, 0 where that isn't available.
+        static std::uint64_t fileId(const fs::path& path)
+        {
+#ifndef _WIN32
+            struct stat info{};
+            if(stat(path.c_str(), &info) == 0)
+                return static_cast<std::uint64_t>(info.st_ino);
+#endif
+            return 0;
+        }
+
+        void setSnapshotTail(std::string_view read)
+        {
+            mSnapshotTail.append(read.substr(read.size() - std::min(read.size(), kTailSize)));
+            if(mSnapshotTail.size() > kTailSize)
+                mSnapshotTail.erase(0, mSnapshotTail.size() - kTailSize);
+        }
+
+        // Calls fn for every complete line in buffer and returns how many bytes those lines covered.
+        template<typename F>
+        static std::size_t forEachLine(std::string_view buffer, F&& fn)
+        {
+            std::size_t begin = 0;
+            std::size_t end;
+            while((end = buffer.find('\n', begin)) != std::string_view::npos)
+            {
+                std::size_t len = end - begin;
+                if(len > 0 && buffer[end - 1] == '\r')
+                    len--;
+                fn(buffer.substr(begin, len));
+                begin = end + 1;
+            }
+            return begin;
+        }
+
+        template<typename T>
+        static bool readNumber(std::string_view& input, T& value)
+        {
+            auto [ptr, ec] = std::from_chars(input.data(), input.data() + input.size(), value);
+            if(ec != std::errc())
+                return false;
+            input.remove_prefix(static_cast<std::size_t>(ptr - input.data()));
+            if(!input.empty() && input.front() == ' ')
+                input.remove_prefix(1);
+            return true;
+        }
+
+        // Largest id a full read gives the lines of a snapshot or, with journal set, the + records of a
+        // journal. The file is read in chunks, so this takes as little memory for millions of entries as
+        // for a handful.
+        static std::uint32_t maxIdIn(const fs::path& path, const bool& journal)
+        {
+            constexpr std::size_t chunkSize = 1 << 20;
+            std::uint32_t maxId = 0;
+            auto scan = [&](std::string_view line)
+            {
+                std::uint32_t id = 0;
+                if(!journal)
+                    id = EntryStore::parse(line, maxId + 1).mId;
+                else if(line.size() > 2 && line[0] == '+' && line[1] == ' ')
+                {
+                    line.remove_prefix(2);
+                    readNumber(line, id);
+                }
+                maxId = std::max(maxId, journal || id != 0 ? id : maxId + 1);
+            };
+
+            std::ifstream inStream(path, std::ios::binary);
+            std::string buffer;
+            while(inStream)
+            {
+                std::size_t size = buffer.size();
+                buffer.resize(size + chunkSize);
+                inStream.read(buffer.data() + size, chunkSize);
+                buffer.resize(size + static_cast<std::size_t>(inStream.gcount()));
+                buffer.erase(0, forEachLine(buffer, scan));
+            }
+            if(!journal && !buffer.empty())
+                scan(buffer);
+            return maxId;
+        }
+
+        template<typename T>
+        static void appendNumber(Entry& out, const T& value)
+        {
+            char digits[24];
+            auto [ptr, ec] = std::to_chars(digits, digits + sizeof(digits), value);
+            out.append(digits, ptr);
+        }
+
+        static std::uint32_t slotOf(const State& state, const std::uint32_t& id)
+        {
+            auto it = state.mSlots.find(id);
+            return it == state.mSlots.end() ? OrderTree::kNil : it->second;
+        }
+
+        // Position right behind afterId: the front for 0 and the end if afterId was deleted.
+        static std::uint32_t positionAfter(const State& state, const std::uint32_t& afterId)
+        {
+            if(afterId == 0)
+                return 0;
+            std::uint32_t slot = slotOf(state, afterId);
+            if(slot == OrderTree::kNil)
+                return state.mOrder.size();
+            return state.mOrder.positionOf(slot) + 1;
+        }
+
+        static std::uint32_t idBefore(const State& state, const std::uint32_t& position)
+        {
+            return position == 0 ? 0 : state.mStore.id(state.mOrder.at(position - 1));
+        }
+
+        static std::uint32_t insertEntry(State& state, const std::uint32_t& id, const std::uint32_t& afterId,
+                                         const std::int64_t& created, std::string_view text)
+        {
+            std::uint32_t position = positionAfter(state, afterId);
+            auto slot = static_cast<std::uint32_t>(state.mStore.size());
+            state.mStore.push(id, false, text, created);
+            state.mSlots[id] = slot;
+            state.mOrder.insert(position, slot);
+            state.mNextId = std::max(state.mNextId, id + 1);
+            return position;
+        }
+
+        static void removeEntry(State& state, const std::uint32_t& slot)
+        {
+            state.mOrder.erase(slot);
+            state.mSlots.erase(state.mStore.id(slot));
+            state.mStore.erase(slot);
+        }
+
+        // Applies one journal record; records for entries that no longer exist are skipped. With a
+        // result, the screen lines the record touched are collected as well.
+        static void applyRecord(State& state, std::string_view record, ReloadResult* result)
+        {
+            if(record.size() < 3 || record[1] != ' ')
+                return;
+            char op = record[0];
+            record.remove_prefix(2);
+
+            std::uint32_t id = 0;
+            if(!readNumber(record, id))
+                return;
+
+            if(op == '+')
+            {
+                std::uint32_t afterId = 0;
+                std::int64_t created = 0;
+                if(!readNumber(record, afterId) || !readNumber(record, created))
+                    return;
+
+                // Another tool appended a snapshot line under an id the journal already handed out. The
+                // line moves to the next free id, which is what a process that saw the line arrive after
+                // the record gave it, so both entries survive and everyone agrees on their ids.
+                std::uint32_t existing = slotOf(state, id);
+                if(existing != OrderTree::kNil)
+                {
+                    std::uint32_t freshId = state.mNextId++;
+                    state.mSlots.erase(id);
+                    state.mSlots[freshId] = existing;
+                    state.mStore.setId(existing, freshId);
+                }
+
+                std::uint32_t position = insertEntry(state, id, afterId, created, record);
+                if(!result)
+                    return;
+                bool appended = position + 1 == state.mOrder.size()
+                                && (result->mAppendedCount == 0 || result->mFirstAppended + result->mAppendedCount == position);
+                if(!appended)
+                    result->mFullRedraw = true;
+                else if(result->mAppendedCount++ == 0)
+                    result->mFirstAppended = position;
+                return;
+            }
+
+            std::uint32_t slot = slotOf(state, id);
+            if(slot == OrderTree::kNil)
+                return;
+
+            if(op == 'd' || op == 'u')
+            {
+                state.mStore.setDone(slot, op == 'd');
+                if(result)
+                    result->mChangedLines.emplace_back(state.mOrder.positionOf(slot));
+            }
+            else if(op == '-')
+            {
+                removeEntry(state, slot);
+                if(result)
+                    result->mFullRedraw = true;
+            }
+            else if(op == 'm')
+            {
+                std::uint32_t afterId = 0;
+                if(!readNumber(record, afterId) || afterId == id)
+                    return;
+                state.mOrder.erase(slot);
+                state.mOrder.insert(positionAfter(state, afterId), slot);
+                if(result)
+                    result->mFullRedraw = true;
+            }
+        }
+
+        // Reads the creation times recorded in the meta file past mMetaSize, which is 0 for all of them.
+        void readMeta(std::pmr::unordered_map<std::uint32_t, std::int64_t>& created)
+        {
+            constexpr std::size_t recordSize = sizeof(std::uint32_t) + sizeof(std::int64_t);
+            Entry& buffer = mReadBuffer;
+            std::error_code ec;
+            std::uintmax_t size = fs::file_size(mMetaPath, ec);
+            if(ec || size < sizeof(kMetaMagic) || size <= mMetaSize || !readRange(mMetaPath, mMetaSize, size - mMetaSize, buffer)
+               || (mMetaSize == 0 && std::memcmp(buffer.data(), kMetaMagic, sizeof(kMetaMagic)) != 0))
+                return;
+
+            std::size_t begin = mMetaSize == 0 ? sizeof(kMetaMagic) : 0;
+            created.reserve(created.size() + (buffer.size() - begin) / recordSize);
+            std::size_t offset = begin;
+            for(; offset + recordSize <= buffer.size(); offset += recordSize)
+            {
+                std::uint32_t id;
+                std::int64_t time;
+                std::memcpy(&id, buffer.data() + offset, sizeof(id));
+                std::memcpy(&time, buffer.data() + offset + sizeof(id), sizeof(time));
+                created[id] = time;
+            }
+            mMetaSize += offset;
+        }
+
+        // Builds state from snapshot and journal as they are on disk right now.
+        void readState(State& state)
+        {
+            std::error_code ec;
+            mSnapshotSize = fs::file_size(mPath, ec);
+            if(ec)
+                mSnapshotSize = 0;
+            mSnapshotWriteTime = fs::last_write_time(mPath, ec);
+            // Taken before reading, so a replacement in between is caught by the next reload.
+            mSnapshotFile = fileId(mPath);
+            std::int64_t fallbackTime = toSeconds(mSnapshotWriteTime);
+
+            std::pmr::unordered_map<std::uint32_t, std::int64_t> created(&mPool);
+            mMetaSize = 0;
+            readMeta(created);
+
+            Entry& buffer = mReadBuffer;
+            if(!readRange(mPath, 0, mSnapshotSize, buffer))
+                buffer.clear();
+            mSnapshotTail.clear();
+            setSnapshotTail(buffer);
+
+            std::uint32_t maxId = 0;
+            auto addLine = [&](std::string_view line)
+            {
+                auto parsed = EntryStore::parse(line, maxId + 1);
+                // Hand edited files may repeat an id; later duplicates get fresh ones.
+                if(parsed.mId == 0 || state.mSlots.contains(parsed.mId))
+                    parsed.mId = maxId + 1;
+                maxId = std::max(maxId, parsed.mId);
+
+                auto time = created.find(parsed.mId);
+                auto slot = static_cast<std::uint32_t>(state.mStore.size());
+                state.mStore.push(parsed.mId, parsed.mDone, parsed.mText, time == created.end() ? fallbackTime : time->second);
+                state.mSlots[parsed.mId] = slot;
+            };
+            std::size_t consumed = forEachLine(buffer, addLine);
+            if(consumed < buffer.size())
+                addLine(std::string_view(buffer).substr(consumed));
+
+            state.mOrder.build(static_cast<std::uint32_t>(state.mStore.size()));
+            state.mNextId = maxId + 1;
+
+            mJournalSize = 0;
+            mJournalRecords = 0;
+            std::uintmax_t journalSize = fs::file_size(mJournalPath, ec);
+            if(ec || journalSize == 0 || !readRange(mJournalPath, 0, journalSize, buffer))
+                return;
+
+            mJournalSize = forEachLine(buffer, [&](std::string_view record)
+            {
+                applyRecord(state, record, nullptr);
+                mJournalRecords++;
+            });
+        }
+
+        // Rebuilds everything from disk and reports which positions differ from what was shown before.
+        ReloadResult readAll()
+        {
+            ReloadResult result;
+            State fresh(&mPool);
+            readState(fresh);
+
+            const EntryStore& oldStore = mState.mStore;
+            const EntryStore& newStore = fresh.mStore;
+            std::uint32_t oldSlot = mState.mOrder.first();
+            std::uint32_t newSlot = fresh.mOrder.first();
+            std::size_t position = 0;
+            while(oldSlot != OrderTree::kNil && newSlot != OrderTree::kNil)
+            {
+                if(oldStore.done(oldSlot) != newStore.done(newSlot) || oldStore.text(oldSlot) != newStore.text(newSlot))
+                    result.mChangedLines.emplace_back(position);
+                oldSlot = mState.mOrder.next(oldSlot);
+                newSlot = fresh.mOrder.next(newSlot);
+                position++;
+            }
+
+            if(oldSlot != OrderTree::kNil)
+                result.mFullRedraw = true;
+            else
+            {
+                result.mFirstAppended = position;
+                result.mAppendedCount = fresh.mOrder.size() - position;
+            }
+
+            result.mChanged = result.mFullRedraw || !result.mChangedLines.empty() || result.mAppendedCount > 0;
+            mState = std::move(fresh);
+            return result;
+        }
+
+        // Whether the snapshot is still the file that was read and the bytes in front of the known end
+        // are unchanged, so growing means lines were appended.
+        bool tailMatches()
+        {
+            if(mSnapshotFile == 0 || fileId(mPath) != mSnapshotFile)
+                return false;
+            if(mSnapshotSize == 0)
+                return true;
+            if(mSnapshotTail.size() != std::min<std::uintmax_t>(kTailSize, mSnapshotSize) || mSnapshotTail.back() != '\n')
+                return false;
+            Entry& buffer = mReadBuffer;
+            return readRange(mPath, mSnapshotSize - mSnapshotTail.size(), mSnapshotTail.size(), buffer) && buffer == mSnapshotTail;
+        }
+
+        // Parses the lines appended to the snapshot since it was read; they go behind everything else,
+        // which is also where a full read puts them. Only lines under ids never handed out before are
+        // taken this way. Anything else is renumbered by a full read instead, so that every process
+        // ends up with the same ids whichever way it read the file.
+        bool readAppended(const std::uintmax_t& size, const fs::file_time_type& writeTime, ReloadResult& result)
+        {
+            std::pmr::unordered_map<std::uint32_t, std::int64_t> created(&mPool);
+            readMeta(created);
+
+            Entry& buffer = mReadBuffer;
+            if(!readRange(mPath, mSnapshotSize, size - mSnapshotSize, buffer))
+                return false;
+
+            // A partially written last line stays on disk until the writer finishes it.
+            std::uint32_t nextId = mState.mNextId;
+            bool fresh = true;
+            std::size_t consumed = forEachLine(buffer, [&](std::string_view line)
+            {
+                std::uint32_t id = EntryStore::parse(line, 0).mId;
+                fresh = fresh && id >= nextId;
+                nextId = id + 1;
+            });
+            if(!fresh)
+                return false;
+
+            std::int64_t fallbackTime = toSeconds(writeTime);
+            forEachLine(std::string_view(buffer).substr(0, consumed), [&](std::string_view line)
+            {
+                auto parsed = EntryStore::parse(line, 0);
+                auto time = created.find(parsed.mId);
+                auto slot = static_cast<std::uint32_t>(mState.mStore.size());
+                mState.mStore.push(parsed.mId, parsed.mDone, parsed.mText, time == created.end() ? fallbackTime : time->second);
+                mState.mSlots[parsed.mId] = slot;
+                mState.mOrder.insert(mState.mOrder.size(), slot);
+                mState.mNextId = parsed.mId + 1;
+                if(result.mAppendedCount++ == 0)
+                    result.mFirstAppended = mState.mOrder.size() - 1;
+            });
+
+            mSnapshotSize += consumed;
+            mSnapshotWriteTime = writeTime;
+            setSnapshotTail(std::string_view(buffer).substr(0, consumed));
+            return true;
+        }
+
+        ReloadResult reloadLocked()
+        {
+            std::error_code ec;
+            std::uintmax_t snapshotSize = fs::file_size(mPath, ec);
+            if(ec)
+                return {};
+            fs::file_time_type snapshotWriteTime = fs::last_write_time(mPath, ec);
+            if(ec)
+                return {};
+            std::uintmax_t journalSize = fs::file_size(mJournalPath, ec);
+            if(ec)
+                journalSize = 0;
+
+            // Lines appended to the snapshot are parsed on their own, a rewrite means a full read.
+            ReloadResult result;
+            bool appended = snapshotSize > mSnapshotSize && journalSize >= mJournalSize && tailMatches();
+            if(!appended && (snapshotSize != mSnapshotSize || snapshotWriteTime != mSnapshotWriteTime || journalSize < mJournalSize))
+                return readAll();
+            if(appended && !readAppended(snapshotSize, snapshotWriteTime, result))
+                return readAll();
+
+            // Then the records appended to the journal are replayed.
+            if(journalSize > mJournalSize)
+            {
+                Entry& buffer = mReadBuffer;
+                if(!readRange(mJournalPath, mJournalSize, journalSize - mJournalSize, buffer))
+                {
+                    // The appended lines aren't on screen yet, so a diff against them can't be trusted.
+                    result = readAll();
+                    if(appended)
+                        result.mChanged = result.mFullRedraw = true;
+                    return result;
+                }
+
+                // A partially written record stays on disk until the writer finishes it.
+                mJournalSize += forEachLine(buffer, [&](std::string_view record)
+                {
+                    applyRecord(mState, record, &result);
+                    mJournalRecords++;
+                });
+            }
+            result.mChanged = result.mFullRedraw || !result.mChangedLines.empty() || result.mAppendedCount > 0;
+            return result;
+        }
+
+        // Runs one change under the journal lock. Records other processes wrote are merged first; then
+        // apply validates its arguments, updates the state and returns the records to append, which go
+        // out in one write. Only the region past the current end of the journal is locked. If the write
+        // fails, whatever part of it reached the journal is cut off again and the state is read back
+        // from disk, so the change apply made in memory doesn't outlive it.
+        template<typename F>
+        bool mutate(F&& apply)
+        {
+            {
+                std::error_code ec;
+                std::uintmax_t end = fs::file_size(mJournalPath, ec);
+                FileLock lock(mJournalPath, LockMode::exclusive, ec ? 0 : end);
+                if(lock.failed())
+                    return false;
+                reloadLocked();
+
+                Entry& records = mWriteBuffer;
+                records.clear();
+                std::size_t count = apply(records);
+                if(count == 0)
+                    return false;
+
+                // Nobody else appends while the lock is held, so the journal still ends at end.
+                if(ec)
+                    end = 0;
+                if(!FileHandler::WriteToFile(mJournalPath, records, std::ios::app))
+                {
+                    std::uintmax_t written = fs::file_size(mJournalPath, ec);
+                    if(!ec && written > end)
+                        fs::resize_file(mJournalPath, end, ec);
+                    readAll();
+                    return false;
+                }
+                mJournalSize += records.size();
+                mJournalRecords += count;
+            }
+
+            // Keeps replay on load cheap next to parsing the snapshot.
+            if(mJournalRecords > std::max(kCompactThreshold, mState.mStore.liveCount()))
+                compact();
+            return true;
+        }
+
+        bool compactLocked()
+        {
+            Entry& out = mWriteBuffer;
+            out.clear();
+            Entry meta(kMetaMagic, sizeof(kMetaMagic), &mPool);
+            forEach([&](const std::size_t&, const std::uint32_t& slot)
+            {
+                mState.mStore.format(slot, out);
+                out += '\n';
+
+                std::uint32_t id = mState.mStore.id(slot);
+                std::int64_t created = mState.mStore.created(slot);
+                meta.append(reinterpret_cast<const char*>(&id), sizeof(id));
+                meta.append(reinterpret_cast<const char*>(&created), sizeof(created));
+            });
+
+            // The snapshot is replaced rather than rewritten, which readers take as the sign to read it
+            // in full; the old one stays intact until the new one is complete.
+            FileLock snapshotLock(mPath, LockMode::exclusive);
+            if(snapshotLock.failed())
+                return false;
+            fs::path temp = mPath;
+            temp += ".tmp";
+            if(!FileHandler::WriteToFile(temp, out) || !FileHandler::WriteToFile(mMetaPath, meta))
+                return false;
+            std::error_code ec;
+            fs::rename(temp, mPath, ec);
+            if(ec)
+            {
+                std::cerr << "Failed to replace: " << mPath << " : " << ec.message() << std::endl;
+                return false;
+            }
+            if(!FileHandler::WriteToFile(mJournalPath, std::string()))
+                return false;
+
+            mSnapshotSize = out.size();
+            mSnapshotWriteTime = fs::last_write_time(mPath, ec);
+            mSnapshotFile = fileId(mPath);
+            mSnapshotTail.clear();
+            setSnapshotTail(out);
+            mMetaSize = meta.size();
+            mJournalSize = 0;
+            mJournalRecords = 0;
+            return true;
+        }
+
+    public:
+        [[maybe_unused]] List()
+        : mPool(std::pmr::new_delete_resource()), mPath(), mJournalPath(), mMetaPath(), mState(&mPool), mReadBuffer(&mPool),
+          mWriteBuffer(&mPool), mSnapshotSize(0), mSnapshotWriteTime(), mSnapshotFile(0), mSnapshotTail(&mPool),
+          mMetaSize(0), mJournalSize(0), mJournalRecords(0)
+        {}
+
+        List(const List&) = delete;
+        List& operator=(const List&) = delete;
+
+        [[maybe_unused]] bool load(const fs::path& path)
+        {
+            if(!fs::exists(path))
+                return false;
+
+            mPath = path;
+            mJournalPath = fs::path(path).replace_extension(".journal");
+            mMetaPath = fs::path(path).replace_extension(".meta");
+            release();
+
+            // Only the records present right now are locked, so processes appending to the journal
+            // aren't held up.
+            std::error_code ec;
+            std::uintmax_t journalSize = fs::file_size(mJournalPath, ec);
+            FileLock lock(mJournalPath, LockMode::shared, 0, ec ? 0 : journalSize);
+            readState(mState);
+            return true;
+        }
+
+        [[maybe_unused]] bool add(std::string_view description)
+        {
+            return insert(OrderTree::kNil, description);
+        }
+
+        // Inserts a new entry at position; positions past the end append.
+        [[maybe_unused]] bool insert(std::uint32_t position, std::string_view description)
+        {
+            return mutate([&](Entry& records) -> std::size_t
+            {
+                position = std::min(position, mState.mOrder.size());
+                std::uint32_t id = mState.mNextId;
+                std::uint32_t afterId = idBefore(mState, position);
+                std::int64_t created = now();
+                insertEntry(mState, id, afterId, created, description);
+
+                records += "+ ";
+                appendNumber(records, id);
+                records += ' ';
+                appendNumber(records, afterId);
+                records += ' ';
+                appendNumber(records, created);
+                records += ' ';
+                records += description;
+                records += '\n';
+                return 1;
+            });
+        }
+
+        // Appends all descriptions in order with one journal write.
+        [[maybe_unused]] bool addAll(const std::vector<std::string>& descriptions)
+        {
+            return mutate([&](Entry& records) -> std::size_t
+            {
+                std::int64_t created = now();
+                std::uint32_t afterId = idBefore(mState, mState.mOrder.size());
+                for(const std::string& description : descriptions)
+                {
+                    std::uint32_t id = mState.mNextId;
+                    insertEntry(mState, id, afterId, created, description);
+
+                    records += "+ ";
+                    appendNumber(records, id);
+                    records += ' ';
+                    appendNumber(records, afterId);
+                    records += ' ';
+                    appendNumber(records, created);
+                    records += ' ';
+                    records += description;
+                    records += '\n';
+                    afterId = id;
+                }
+                return descriptions.size();
+            });
+        }
+
+        // Marks the entries at the given ascending positions done or open again with one journal write.
+        // Nothing changes if a position is out of range; entries already in that state are skipped.
+        // Returns whether anything was written, so false is also the answer for a selection that was
+        // already in that state; see isDone.
+        [[maybe_unused]] bool setDone(const std::vector<std::uint32_t>& positions, const bool& done)
+        {
+            return mutate([&](Entry& records) -> std::size_t
+            {
+                // Another process may have deleted entries in the meantime.
+                if(positions.empty() || positions.back() >= mState.mOrder.size())
+                    return 0;
+
+                std::size_t count = 0;
+                std::uint32_t slot = OrderTree::kNil;
+                for(std::size_t i = 0; i < positions.size(); i++)
+                {
+                    // Runs of neighbours are walked instead of searched for.
+                    slot = i > 0 && positions[i] == positions[i - 1] + 1 ? mState.mOrder.next(slot) : mState.mOrder.at(positions[i]);
+                    if(mState.mStore.done(slot) == done)
+                        continue;
+                    mState.mStore.setDone(slot, done);
+
+                    records += done ? "d " : "u ";
+                    appendNumber(records, mState.mStore.id(slot));
+                    records += '\n';
+                    count++;
+                }
+                return count;
+            });
+        }
+
+        // Whether every entry at the given ascending positions is already done (or open), which leaves
+        // setDone nothing to write.
+        [[maybe_unused]] bool isDone(const std::vector<std::uint32_t>& positions, const bool& done) const
+        {
+            if(positions.empty() || positions.back() >= mState.mOrder.size())
+                return false;
+            return std::all_of(positions.begin(), positions.end(), [&](const std::uint32_t& position)
+            {
+                return mState.mStore.done(mState.mOrder.at(position)) == done;
+            });
+        }
+
+        [[maybe_unused]] bool remove(const std::size_t& position)
+        {
+            return mutate([&](Entry& records) -> std::size_t
+            {
+                if(position >= mState.mOrder.size())
+                    return 0;
+                std::uint32_t slot = mState.mOrder.at(static_cast<std::uint32_t>(position));
+
+                records += "- ";
+                appendNumber(records, mState.mStore.id(slot));
+                records += '\n';
+                removeEntry(mState, slot);
+                return 1;
+            });
+        }
+
+        // Moves the entry at position from so that it ends up at position to.
+        [[maybe_unused]] bool move(const std::size_t& from, const std::size_t& to)
+        {
+            return mutate([&](Entry& records) -> std::size_t
+            {
+                if(from >= mState.mOrder.size() || to >= mState.mOrder.size())
+                    return 0;
+                std::uint32_t slot = mState.mOrder.at(static_cast<std::uint32_t>(from));
+                mState.mOrder.erase(slot);
+                std::uint32_t afterId = idBefore(mState, static_cast<std::uint32_t>(to));
+                mState.mOrder.insert(static_cast<std::uint32_t>(to), slot);
+
+                records += "m ";
+                appendNumber(records, mState.mStore.id(slot));
+                records += ' ';
+                appendNumber(records, afterId);
+                records += '\n';
+                return 1;
+            });
+        }
+
+        // Folds the journal into the snapshot, so tools reading foo.txt see the current list again.
+        [[maybe_unused]] bool compact()
+        {
+            FileLock lock(mJournalPath, LockMode::exclusive);
+            if(lock.failed())
+                return false;
+            reloadLocked();
+            if(mJournalRecords == 0)
+                return true;
+            return compactLocked();
+        }
+
+        // Appends many entries straight to the snapshot at path. write(firstId, snapshot, meta) gets the
+        // id of the first new entry and streams lines in the list file format and their meta records.
+        // Ids continue behind the largest one in the snapshot and the journal, which are scanned rather
+        // than loaded, so a bulk import never needs the list in memory; lists that have it open pick the
+        // new entries up on their next reload.
+        template<typename F>
+        static bool appendBulk(const fs::path& path, F&& write)
+        {
+            fs::path journalPath = fs::path(path).replace_extension(".journal");
+            fs::path metaPath = fs::path(path).replace_extension(".meta");
+            FileLock lock(journalPath, LockMode::exclusive);
+            FileLock snapshotLock(path, LockMode::exclusive);
+            if(lock.failed() || snapshotLock.failed())
+                return false;
+            std::uint32_t firstId = std::max(maxIdIn(path, false), maxIdIn(journalPath, true)) + 1;
+
+            std::error_code ec;
+            std::uintmax_t snapshotSize = fs::file_size(path, ec);
+            std::uintmax_t metaSize = fs::file_size(metaPath, ec);
+            if(ec)
+                metaSize = 0;
+            Entry last;
+            bool needsNewline = snapshotSize > 0 && readRange(path, snapshotSize - 1, 1, last) && last[0] != '\n';
+
+            std::ofstream snapshot(path, std::ios::binary | std::ios::app);
+            std::ofstream meta(metaPath, std::ios::binary | std::ios::app);
+            if(!snapshot.is_open() || !meta.is_open())
+            {
+                std::cerr << "Failed to open: " << path << " : " << std::strerror(errno) << std::endl;
+                return false;
+            }
+            if(needsNewline)
+                snapshot.put('\n');
+            if(metaSize == 0)
+                meta.write(kMetaMagic, sizeof(kMetaMagic));
+
+            bool ok = write(firstId, snapshot, meta);
+            snapshot.close();
+            meta.close();
+            return ok && !snapshot.fail() && !meta.fail();
+        }
+
+        // Picks up changes other processes made. New journal records are replayed from the last known
+        // offset; a rewritten snapshot means a full reload that is diffed against the entries in memory.
+        [[maybe_unused]] ReloadResult reload()
+        {
+            FileLock lock(mJournalPath, LockMode::shared);
+            return reloadLocked();
+        }
+
+        [[maybe_unused]] const fs::path& path() const
+        {
+            return mPath;
+        }
+
+        [[maybe_unused]] const fs::path& journalPath() const
+        {
+            return mJournalPath;
+        }
+
+        [[maybe_unused]] const EntryStore& store() const
+        {
+            return mState.mStore;
+        }
+
+        [[maybe_unused]] const OrderTree& order() const
+        {
+            return mState.mOrder;
+        }
+
+        [[maybe_unused]] std::size_t size() const
+        {
+            return mState.mOrder.size();
+        }
+
+        // Slot of the entry with the given id, OrderTree::kNil if there is none.
+        [[maybe_unused]] std::uint32_t slotOf(const std::uint32_t& id) const
+        {
+            return slotOf(mState, id);
+        }
+
+        // Calls fn(position, slot) for every entry in list order.
+        template<typename F>
+        void forEach(F&& fn) const
+        {
+            std::size_t position = 0;
+            for(std::uint32_t slot = mState.mOrder.first(); slot != OrderTree::kNil; slot = mState.mOrder.next(slot))
+                fn(position++, slot);
+        }
+
+        // Appends the entry at position as shown on screen, numbered by position rather than by id.
+        template<typename String>
+        void format(const std::size_t& position, String& out) const
+        {
+            mState.mStore.format(mState.mOrder.at(static_cast<std::uint32_t>(position)), out, position + 1);
+        }
+
+        // Drops all entries and buffers, then hands the pool's memory back at once.
+        [[maybe_unused]] void release()
+        {
+            mState = State(&mPool);
+            // Swapped rather than assigned: assigning an empty string keeps the old buffer.
+            Entry(&mPool).swap(mReadBuffer);
+            Entry(&mPool).swap(mWriteBuffer);
+            Entry(&mPool).swap(mSnapshotTail);
+            mPool.release();
+        }
+    };
+}
+#endif // TODO_LIST_HPP